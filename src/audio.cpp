@@ -4,17 +4,20 @@
 
 #include "audio.h"
 
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "profiler.h"
 #include "ring_buffer.h"
 #include "vera/vera_pcm.h"
 #include "vera/vera_psg.h"
 #include "ym2151/ym2151.h"
 
 static SDL_AudioDeviceID Audio_dev            = 0;
+static bool              Audio_offline        = false;
 static int               Obtained_sample_rate = 0;
 static int               Clocks_per_sample    = 0;
 
@@ -32,17 +35,7 @@ static ring_allocator<audio_buffer, BACKBUFFER_COUNT> Audio_backbuffer;
 static constexpr size_t Low_buffer_threshold = 2;
 static int              Clocks_rendered      = 0;
 
-static volatile audio_render_callback Render_callback = nullptr;
-
-audio_lock_scope::audio_lock_scope()
-{
-	SDL_LockAudio();
-}
-
-audio_lock_scope::~audio_lock_scope()
-{
-	SDL_UnlockAudio();
-}
+static audio_render_callback Render_callback = nullptr;
 
 static void audio_callback_nop(const int16_t *, const int)
 {
@@ -59,11 +52,12 @@ static void audio_render_buffer()
 	SDL_MixAudioFormat(reinterpret_cast<uint8_t *>(buffer), reinterpret_cast<uint8_t *>(Psg_buffer), AUDIO_S16, sizeof(Psg_buffer), SDL_MIX_MAXVOLUME);
 	SDL_MixAudioFormat(reinterpret_cast<uint8_t *>(buffer), reinterpret_cast<uint8_t *>(Pcm_buffer), AUDIO_S16, sizeof(Pcm_buffer), SDL_MIX_MAXVOLUME);
 
-	// Commit to the backbuffer
-	{
-		audio_lock_scope lock;
-		audio_buffer *   backbuffer = Audio_backbuffer.allocate();
-		memcpy(backbuffer->data, buffer, sizeof(buffer));
+	// Commit to the backbuffer. If the device has fallen this far behind, the new buffer is dropped.
+	if (Audio_dev != 0) {
+		if (audio_buffer *backbuffer = Audio_backbuffer.allocate(); backbuffer != nullptr) {
+			memcpy(backbuffer->data, buffer, sizeof(buffer));
+			Audio_backbuffer.commit();
+		}
 	}
 
 	Render_callback(reinterpret_cast<int16_t *>(buffer), SAMPLES_PER_BUFFER);
@@ -78,8 +72,13 @@ static void audio_callback(void *, Uint8 *stream, int len)
 	}
 
 	const audio_buffer *buffer = Audio_backbuffer.get_oldest();
+	if (buffer == nullptr) {
+		memset(stream, 0, len);
+		return;
+	}
 	memcpy(stream, buffer->data, len);
 
+	// Keep the last buffer to replay, rather than leave a gap if the emulation falls behind.
 	if (Audio_backbuffer.count() > 1) {
 		Audio_backbuffer.free_oldest();
 	}
@@ -87,7 +86,7 @@ static void audio_callback(void *, Uint8 *stream, int len)
 
 void audio_init(const char *dev_name, int /*num_audio_buffers*/)
 {
-	if (Audio_dev > 0) {
+	if (Audio_dev > 0 || Audio_offline) {
 		audio_close();
 	}
 
@@ -118,17 +117,31 @@ void audio_init(const char *dev_name, int /*num_audio_buffers*/)
 	fmt::print("INFO: Audio buffer is {} bytes\n", obtained.size);
 
 	// Prime the buffer
-	{
-		auto backbuffer = Audio_backbuffer.allocate();
+	if (audio_buffer *backbuffer = Audio_backbuffer.allocate(); backbuffer != nullptr) {
 		memset(backbuffer->data, 0, sizeof(backbuffer->data));
+		Audio_backbuffer.commit();
 	}
 
 	// Start playback
 	SDL_PauseAudioDevice(Audio_dev, 0);
 }
 
+void audio_init_offline()
+{
+	if (Audio_dev > 0) {
+		audio_close();
+	}
+
+	Render_callback      = audio_callback_nop;
+	Obtained_sample_rate = SAMPLERATE;
+	Clocks_per_sample    = 8000000 / Obtained_sample_rate;
+	Clocks_rendered      = 0;
+	Audio_offline        = true;
+}
+
 void audio_close(void)
 {
+	Audio_offline = false;
 	if (Audio_dev == 0) {
 		return;
 	}
@@ -139,9 +152,12 @@ void audio_close(void)
 
 void audio_render(int cpu_clocks)
 {
-	YM_prerender(cpu_clocks);
+	{
+		profiler_scope scope(profiler_section::ym);
+		YM_prerender(cpu_clocks);
+	}
 
-	if (Audio_dev == 0) {
+	if (Audio_dev == 0 && !Audio_offline) {
 		YM_clear_backbuffer();
 		return;
 	}
@@ -154,11 +170,21 @@ void audio_render(int cpu_clocks)
 		Clocks_rendered -= Clocks_per_sample * SAMPLES_PER_BUFFER;
 	}
 
-	while (Audio_backbuffer.count() < Low_buffer_threshold) {
+	// Nothing drains the backbuffer without a device, so there is nothing to keep topped up.
+	while (Audio_dev != 0 && Audio_backbuffer.count() < Low_buffer_threshold) {
 		audio_render_buffer();
 	}
 }
 
+int audio_clocks_until_next_buffer()
+{
+	if (Audio_dev == 0 && !Audio_offline) {
+		return INT_MAX;
+	}
+	const int clocks = Clocks_per_sample * SAMPLES_PER_BUFFER - Clocks_rendered;
+	return clocks > 1 ? clocks : 1;
+}
+
 void audio_usage(void)
 {
 	// SDL_GetAudioDeviceName doesn't work if audio isn't initialized.
@@ -179,19 +205,16 @@ void audio_usage(void)
 
 void audio_get_psg_buffer(int16_t *dst)
 {
-	audio_lock_scope lock;
 	memcpy(dst, Psg_buffer, 2 * SAMPLES_PER_BUFFER * sizeof(int16_t));
 }
 
 void audio_get_pcm_buffer(int16_t *dst)
 {
-	audio_lock_scope lock;
 	memcpy(dst, Pcm_buffer, 2 * SAMPLES_PER_BUFFER * sizeof(int16_t));
 }
 
 void audio_get_ym_buffer(int16_t *dst)
 {
-	audio_lock_scope lock;
 	memcpy(dst, Ym_buffer, 2 * SAMPLES_PER_BUFFER * sizeof(int16_t));
 }
 
@@ -202,6 +225,5 @@ int audio_get_sample_rate()
 
 void audio_set_render_callback(audio_render_callback cb)
 {
-	audio_lock_scope lock;
 	Render_callback = cb;
 }
\ No newline at end of file
@@ -14,18 +14,17 @@
 #	define SAMPLES_PER_BUFFER (256)
 #endif
 
-class audio_lock_scope
-{
-public:
-	audio_lock_scope();
-	~audio_lock_scope();
-};
+// Everything here runs on the emulation thread. Only finished buffers are handed to the audio device,
+// through a lock-free ring, so sound chip state never needs a lock.
 
 using audio_render_callback = void (*)(const int16_t *samples, const int num_samples);
 
 void audio_init(const char *dev_name, int num_audio_buffers);
+// Render audio as if a device were open, but discard it (apart from the render callback).
+void audio_init_offline();
 void audio_close(void);
 void audio_render(int cpu_clocks);
+int  audio_clocks_until_next_buffer();
 
 void audio_usage(void);
 
@@ -0,0 +1,471 @@
+#include "benchmark.h"
+
+#include <SDL.h>
+#include <fmt/format.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "files.h"
+#include "glue.h"
+#include "keyboard.h"
+#include "memory.h"
+#include "options.h"
+#include "profiler.h"
+#include "vera/vera_video.h"
+#include "version.h"
+
+//
+// Each workload resets the machine, lets the KERNAL boot, then starts its own
+// code by typing in BASIC or by dropping a small machine-language program into
+// golden RAM at $0400 and jumping to it. After a short settling period, a fixed
+// number of frames is measured.
+//
+// Section times come from the profiler, which charges whatever no other
+// section accounts for to the CPU.
+//
+
+#define BENCHMARK_BOOT_FRAMES (240)
+#define BENCHMARK_SETTLE_FRAMES (60)
+#define BENCHMARK_PROGRAM_ADDRESS (0x0400)
+
+struct benchmark_workload {
+	const char *name;
+	const char *description;
+	uint32_t    boot_frames;
+	uint32_t    settle_frames;
+	void (*setup)();
+};
+
+struct benchmark_result {
+	const benchmark_workload *workload;
+	uint32_t                  frames;
+	uint64_t                  cycles;
+	uint64_t                  instructions;
+	uint64_t                  perf;
+	uint64_t                  lines_reused;
+	uint64_t                  lines_rendered;
+	profiler_frame            profile;
+};
+
+enum class benchmark_phase {
+	boot,
+	settle,
+	measure
+};
+
+static std::vector<const benchmark_workload *> Workloads;
+static std::vector<benchmark_result>           Results;
+
+static size_t          Current      = 0;
+static benchmark_phase Phase        = benchmark_phase::boot;
+static uint32_t        Phase_frames = 0;
+
+static uint64_t Start_clockticks;
+static uint32_t Start_instructions;
+static uint64_t       Start_perf;
+static profiler_frame Start_profile;
+static uint64_t       Start_lines_reused;
+static uint64_t       Start_lines_rendered;
+
+//
+// Workload programs, assembled for $0400.
+//
+
+static const uint8_t Vera_fill_program[] = {
+	0x78,                   // SEI
+	0x9c, 0x25, 0x9f,       // STZ $9F25 ; ADDRSEL=0, DCSEL=0
+	0xa9, 0x11,             // LDA #$11
+	0x8d, 0x29, 0x9f,       // STA $9F29 ; DC_VIDEO: VGA, layer 0 only
+	0xa9, 0x40,             // LDA #$40
+	0x8d, 0x2a, 0x9f,       // STA $9F2A ; DC_HSCALE: 2x
+	0x8d, 0x2b, 0x9f,       // STA $9F2B ; DC_VSCALE: 2x
+	0xa9, 0x07,             // LDA #$07
+	0x8d, 0x2d, 0x9f,       // STA $9F2D ; L0_CONFIG: 8bpp bitmap
+	0x9c, 0x2f, 0x9f,       // STZ $9F2F ; L0_TILEBASE: $00000, 320 wide
+	0xa2, 0x00,             // LDX #$00 ; X = fill colour
+	// frame:
+	0x9c, 0x20, 0x9f,       // STZ $9F20
+	0x9c, 0x21, 0x9f,       // STZ $9F21
+	0xa9, 0x10,             // LDA #$10
+	0x8d, 0x22, 0x9f,       // STA $9F22 ; ADDR0 = $00000, increment 1
+	0xa9, 0x4b,             // LDA #75
+	0x85, 0x22,             // STA $22 ; 75 x 1024 bytes = 320x240
+	0x8a,                   // TXA
+	// page:
+	0xa0, 0x00,             // LDY #$00
+	// byte:
+	0x8d, 0x23, 0x9f,       // STA $9F23
+	0x8d, 0x23, 0x9f,       // STA $9F23
+	0x8d, 0x23, 0x9f,       // STA $9F23
+	0x8d, 0x23, 0x9f,       // STA $9F23
+	0x88,                   // DEY
+	0xd0, 0xf1,             // BNE byte
+	0xc6, 0x22,             // DEC $22
+	0xd0, 0xeb,             // BNE page
+	0xe8,                   // INX
+	0x4c, 0x1b, 0x04,       // JMP frame
+};
+
+static const uint8_t Fx_lines_program[] = {
+	0x78,                   // SEI
+	0x9c, 0x25, 0x9f,       // STZ $9F25 ; ADDRSEL=0, DCSEL=0
+	0xa9, 0x11,             // LDA #$11
+	0x8d, 0x29, 0x9f,       // STA $9F29 ; DC_VIDEO: VGA, layer 0 only
+	0xa9, 0x40,             // LDA #$40
+	0x8d, 0x2a, 0x9f,       // STA $9F2A ; DC_HSCALE: 2x
+	0x8d, 0x2b, 0x9f,       // STA $9F2B ; DC_VSCALE: 2x
+	0xa9, 0x07,             // LDA #$07
+	0x8d, 0x2d, 0x9f,       // STA $9F2D ; L0_CONFIG: 8bpp bitmap
+	0x9c, 0x2f, 0x9f,       // STZ $9F2F ; L0_TILEBASE: $00000, 320 wide
+	0xa2, 0x00,             // LDX #$00 ; X = slope and colour
+	// line:
+	0xa9, 0x04,             // LDA #$04
+	0x8d, 0x25, 0x9f,       // STA $9F25 ; DCSEL=2
+	0xa9, 0x01,             // LDA #$01
+	0x8d, 0x29, 0x9f,       // STA $9F29 ; FX_CTRL: line draw helper
+	0x9c, 0x20, 0x9f,       // STZ $9F20
+	0x9c, 0x21, 0x9f,       // STZ $9F21
+	0xa9, 0xe0,             // LDA #$E0
+	0x8d, 0x22, 0x9f,       // STA $9F22 ; ADDR0 = $00000, increment 320 (minor axis step)
+	0xa9, 0x05,             // LDA #$05
+	0x8d, 0x25, 0x9f,       // STA $9F25 ; ADDRSEL=1
+	0x9c, 0x20, 0x9f,       // STZ $9F20
+	0x9c, 0x21, 0x9f,       // STZ $9F21
+	0xa9, 0x10,             // LDA #$10
+	0x8d, 0x22, 0x9f,       // STA $9F22 ; ADDR1 = $00000, increment 1 (major axis step)
+	0xa9, 0x06,             // LDA #$06
+	0x8d, 0x25, 0x9f,       // STA $9F25 ; DCSEL=3, ADDRSEL=0
+	0x8e, 0x29, 0x9f,       // STX $9F29
+	0x9c, 0x2a, 0x9f,       // STZ $9F2A ; FX_X_INCR = X / 512
+	0x8a,                   // TXA
+	0xa0, 0xa0,             // LDY #160
+	// pixel:
+	0x8d, 0x24, 0x9f,       // STA $9F24
+	0x8d, 0x24, 0x9f,       // STA $9F24
+	0x88,                   // DEY
+	0xd0, 0xf7,             // BNE pixel
+	0xe8,                   // INX
+	0x4c, 0x1b, 0x04,       // JMP line
+};
+
+static const uint8_t Tile_scroll_program[] = {
+	0x78,                   // SEI
+	0x9c, 0x25, 0x9f,       // STZ $9F25 ; ADDRSEL=0, DCSEL=0
+	0xad, 0x34, 0x9f,       // LDA $9F34
+	0x8d, 0x2d, 0x9f,       // STA $9F2D ; L0_CONFIG = L1_CONFIG
+	0xad, 0x35, 0x9f,       // LDA $9F35
+	0x8d, 0x2e, 0x9f,       // STA $9F2E ; L0_MAPBASE = L1_MAPBASE
+	0xad, 0x36, 0x9f,       // LDA $9F36
+	0x8d, 0x2f, 0x9f,       // STA $9F2F ; L0_TILEBASE = L1_TILEBASE
+	0xad, 0x29, 0x9f,       // LDA $9F29
+	0x09, 0x10,             // ORA #$10
+	0x8d, 0x29, 0x9f,       // STA $9F29 ; DC_VIDEO: enable layer 0
+	// frame:
+	0xcb,                   // WAI
+	0xa9, 0x01,             // LDA #$01
+	0x8d, 0x27, 0x9f,       // STA $9F27 ; acknowledge VSYNC
+	0xee, 0x37, 0x9f,       // INC $9F37 ; L1_HSCROLL_L
+	0xee, 0x39, 0x9f,       // INC $9F39 ; L1_VSCROLL_L
+	0xce, 0x30, 0x9f,       // DEC $9F30 ; L0_HSCROLL_L
+	0xee, 0x32, 0x9f,       // INC $9F32 ; L0_VSCROLL_L
+	0x4c, 0x1e, 0x04,       // JMP frame
+};
+
+static const uint8_t Ym_music_program[] = {
+	0x78,                   // SEI
+	0xa2, 0x20,             // LDX #$20
+	// init:
+	0x8a,                   // TXA
+	0x4a,                   // LSR
+	0x4a,                   // LSR
+	0x4a,                   // LSR
+	0x4a,                   // LSR
+	0x4a,                   // LSR
+	0xa8,                   // TAY
+	0xb9, 0x57, 0x04,       // LDA voice,Y
+	0x20, 0x4b, 0x04,       // JSR ymw ; every register from $20 to $FF
+	0xe8,                   // INX
+	0xd0, 0xf0,             // BNE init
+	// frame:
+	0xcb,                   // WAI
+	0xa9, 0x01,             // LDA #$01
+	0x8d, 0x27, 0x9f,       // STA $9F27 ; acknowledge VSYNC
+	0xe6, 0x22,             // INC $22 ; frame counter
+	0xa0, 0x07,             // LDY #$07
+	// off:
+	0x98,                   // TYA
+	0xa2, 0x08,             // LDX #$08
+	0x20, 0x4b, 0x04,       // JSR ymw ; key off channel Y
+	0x88,                   // DEY
+	0x10, 0xf7,             // BPL off
+	0xa0, 0x07,             // LDY #$07
+	// note:
+	0x98,                   // TYA
+	0x18,                   // CLC
+	0x69, 0x28,             // ADC #$28
+	0xaa,                   // TAX
+	0x98,                   // TYA
+	0x0a,                   // ASL
+	0x0a,                   // ASL
+	0x0a,                   // ASL
+	0x65, 0x22,             // ADC $22
+	0x29, 0x7f,             // AND #$7F
+	0x20, 0x4b, 0x04,       // JSR ymw ; KC for channel Y
+	0x88,                   // DEY
+	0x10, 0xed,             // BPL note
+	0xa0, 0x07,             // LDY #$07
+	// on:
+	0x98,                   // TYA
+	0x09, 0x78,             // ORA #$78
+	0xa2, 0x08,             // LDX #$08
+	0x20, 0x4b, 0x04,       // JSR ymw ; key on all operators of channel Y
+	0x88,                   // DEY
+	0x10, 0xf5,             // BPL on
+	0x4c, 0x13, 0x04,       // JMP frame
+	// ymw:
+	0x2c, 0x41, 0x9f,       // BIT $9F41
+	0x30, 0xfb,             // BMI ymw ; wait while busy
+	0x8e, 0x40, 0x9f,       // STX $9F40
+	0x8d, 0x41, 0x9f,       // STA $9F41
+	0x60,                   // RTS
+	// voice:
+	0x00, 0xc7, 0x01, 0x10, 0x1f, 0x05, 0x05, 0xf7, // .byte $00, $C7, $01, $10, $1F, $05, $05, $F7
+};
+
+static void inject_program(const uint8_t *program, uint32_t size)
+{
+	memcpy(RAM + BENCHMARK_PROGRAM_ADDRESS, program, size);
+	memory_mark_dirty(BENCHMARK_PROGRAM_ADDRESS, size);
+	state6502.pc = BENCHMARK_PROGRAM_ADDRESS;
+	waiting      = 0;
+}
+
+static void setup_basic_loop()
+{
+	keyboard_add_text("NEW\r10 A=A+1:B=SIN(A)*A/3:C$=STR$(B)\r20 GOTO 10\rRUN\r");
+}
+
+static void setup_vera_fill()
+{
+	inject_program(Vera_fill_program, sizeof(Vera_fill_program));
+}
+
+static void setup_fx_lines()
+{
+	inject_program(Fx_lines_program, sizeof(Fx_lines_program));
+}
+
+static void setup_tile_scroll()
+{
+	inject_program(Tile_scroll_program, sizeof(Tile_scroll_program));
+}
+
+static void setup_ym_music()
+{
+	inject_program(Ym_music_program, sizeof(Ym_music_program));
+}
+
+static void setup_sd_streaming()
+{
+	// Device 8 is the SD card when one is attached with -sdcard, otherwise the host filesystem.
+	keyboard_add_text("NEW\r10 OPEN1,8,0,\"$\"\r20 GET#1,A$:IF ST=0 THEN 20\r30 CLOSE1:GOTO 10\rRUN\r");
+}
+
+static const benchmark_workload All_workloads[] = {
+	{ "kernal_boot", "KERNAL and BASIC cold start, measured from reset", 0, 0, nullptr },
+	{ "basic_loop", "Interpreted BASIC loop with floating point and string work", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_basic_loop },
+	{ "vera_fill", "Continuous 320x240x8bpp bitmap fill through DATA0", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_vera_fill },
+	{ "fx_lines", "Line drawing with the VERA FX line helper", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_fx_lines },
+	{ "tile_scroll", "Two tile layers scrolling every frame", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_tile_scroll },
+	{ "ym_music", "Eight YM2151 voices retriggered every frame", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_ym_music },
+	{ "sd_streaming", "BASIC reading the device 8 directory in a loop", BENCHMARK_BOOT_FRAMES, BENCHMARK_SETTLE_FRAMES, setup_sd_streaming },
+};
+
+static const benchmark_workload *find_workload(const std::string &name)
+{
+	for (const benchmark_workload &workload : All_workloads) {
+		if (name == workload.name) {
+			return &workload;
+		}
+	}
+	return nullptr;
+}
+
+//
+// Measurement
+//
+
+static void begin_measure()
+{
+	profiler_set_user(profiler_user::benchmark, true);
+	Start_clockticks   = clockticks6502;
+	Start_instructions = instructions;
+	Start_profile      = profiler_get_totals();
+	vera_video_get_line_cache_stats(&Start_lines_reused, &Start_lines_rendered);
+	Start_perf         = SDL_GetPerformanceCounter();
+}
+
+static void end_measure()
+{
+	const uint64_t        end_perf = SDL_GetPerformanceCounter();
+	const profiler_frame &totals   = profiler_get_totals();
+
+	benchmark_result result;
+	result.workload     = Workloads[Current];
+	result.frames       = Phase_frames;
+	result.cycles       = clockticks6502 - Start_clockticks;
+	result.instructions = (uint32_t)(instructions - Start_instructions);
+	result.perf         = end_perf - Start_perf;
+	vera_video_get_line_cache_stats(&result.lines_reused, &result.lines_rendered);
+	result.lines_reused -= Start_lines_reused;
+	result.lines_rendered -= Start_lines_rendered;
+	result.profile.total = totals.total - Start_profile.total;
+	for (int s = 0; s < (int)profiler_section::count; ++s) {
+		result.profile.sections[s] = totals.sections[s] - Start_profile.sections[s];
+	}
+	Results.push_back(result);
+	profiler_set_user(profiler_user::benchmark, false);
+}
+
+// Move through any phases that are already complete.
+static void update_phase()
+{
+	const benchmark_workload &workload = *Workloads[Current];
+	if (Phase == benchmark_phase::boot && Phase_frames >= workload.boot_frames) {
+		if (workload.setup != nullptr) {
+			workload.setup();
+		}
+		Phase        = benchmark_phase::settle;
+		Phase_frames = 0;
+	}
+	if (Phase == benchmark_phase::settle && Phase_frames >= workload.settle_frames) {
+		Phase        = benchmark_phase::measure;
+		Phase_frames = 0;
+		begin_measure();
+	}
+}
+
+static void begin_workload()
+{
+	fmt::print("Benchmark: running {} ({} frames)\n", Workloads[Current]->name, Options.benchmark_frames);
+	machine_reset();
+	Phase        = benchmark_phase::boot;
+	Phase_frames = 0;
+	update_phase();
+}
+
+//
+// Results
+//
+
+static void write_results()
+{
+	const double frequency = (double)SDL_GetPerformanceFrequency();
+
+	std::string json = fmt::format("{{\n\t\"version\": \"{}\",\n\t\"frames\": {},\n\t\"workloads\": [\n", VER_NUM, Options.benchmark_frames);
+	for (size_t i = 0; i < Results.size(); ++i) {
+		const benchmark_result &result  = Results[i];
+		const double            seconds = (double)result.perf / frequency;
+
+		json += "\t\t{\n";
+		json += fmt::format("\t\t\t\"name\": \"{}\",\n", result.workload->name);
+		json += fmt::format("\t\t\t\"frames\": {},\n", result.frames);
+		json += fmt::format("\t\t\t\"cycles\": {},\n", result.cycles);
+		json += fmt::format("\t\t\t\"instructions\": {},\n", result.instructions);
+		json += fmt::format("\t\t\t\"seconds\": {:.6f},\n", seconds);
+		json += fmt::format("\t\t\t\"instructions_per_second\": {:.0f},\n", (double)result.instructions / seconds);
+		json += fmt::format("\t\t\t\"emulated_mhz\": {:.3f},\n", (double)result.cycles / seconds / 1000000.0);
+		json += fmt::format("\t\t\t\"frames_per_second\": {:.2f},\n", (double)result.frames / seconds);
+		json += fmt::format("\t\t\t\"speed_percent\": {:.1f},\n", 100.0 * (double)result.cycles / (MHZ * 1000000.0) / seconds);
+		const uint64_t lines = result.lines_reused + result.lines_rendered;
+		json += fmt::format("\t\t\t\"lines_reused_percent\": {:.1f},\n", lines > 0 ? 100.0 * (double)result.lines_reused / (double)lines : 0.0);
+		json += fmt::format("\t\t\t\"sections\": {{\n\t\t\t\t\"cpu\": {:.6f}", (double)profiler_frame_cpu(result.profile) / frequency);
+		for (int s = 0; s < (int)profiler_section::count; ++s) {
+			json += fmt::format(",\n\t\t\t\t\"{}\": {:.6f}", profiler_section_name((profiler_section)s), (double)result.profile.sections[s] / frequency);
+		}
+		json += "\n\t\t\t}\n";
+		json += (i + 1 < Results.size()) ? "\t\t},\n" : "\t\t}\n";
+	}
+	json += "\t]\n}\n";
+
+	if (Options.benchmark_out_path.empty()) {
+		fmt::print("{}", json);
+		return;
+	}
+
+	x16file *f = x16open(Options.benchmark_out_path.generic_string().c_str(), "w");
+	if (f == nullptr) {
+		fmt::print("Cannot write benchmark results to {}!\n{}", Options.benchmark_out_path.generic_string(), json);
+		return;
+	}
+	x16write(f, json);
+	x16close(f);
+	fmt::print("Benchmark results written to {}\n", Options.benchmark_out_path.generic_string());
+}
+
+//
+// Driver
+//
+
+bool benchmark_start()
+{
+	Workloads.clear();
+	Results.clear();
+
+	if (Options.benchmark == "all") {
+		for (const benchmark_workload &workload : All_workloads) {
+			Workloads.push_back(&workload);
+		}
+	} else {
+		size_t start = 0;
+		while (start <= Options.benchmark.size()) {
+			size_t end = Options.benchmark.find(',', start);
+			if (end == std::string::npos) {
+				end = Options.benchmark.size();
+			}
+			const std::string         name     = Options.benchmark.substr(start, end - start);
+			const benchmark_workload *workload = find_workload(name);
+			if (workload == nullptr) {
+				fmt::print("Unknown benchmark workload \"{}\". Available workloads:\n", name);
+				for (const benchmark_workload &w : All_workloads) {
+					fmt::print("\t{:<14}{}\n", w.name, w.description);
+				}
+				Workloads.clear();
+				return false;
+			}
+			Workloads.push_back(workload);
+			start = end + 1;
+		}
+	}
+
+	Current = 0;
+	begin_workload();
+	return true;
+}
+
+bool benchmark_frame()
+{
+	if (Workloads.empty()) {
+		return true;
+	}
+
+	++Phase_frames;
+	if (Phase != benchmark_phase::measure) {
+		update_phase();
+		return true;
+	}
+	if (Phase_frames < (uint32_t)Options.benchmark_frames) {
+		return true;
+	}
+
+	end_measure();
+	if (++Current < Workloads.size()) {
+		begin_workload();
+		return true;
+	}
+
+	write_results();
+	Workloads.clear();
+	return false;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#if !defined(BENCHMARK_H)
+#	define BENCHMARK_H
+
+// Start the workloads named in Options.benchmark. Returns false if a name is unknown.
+bool benchmark_start();
+
+// Call at the start of each emulated frame. Returns false once every workload has finished
+// and the results have been written, at which point the emulator should exit.
+bool benchmark_frame();
+
+#endif
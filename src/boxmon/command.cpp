@@ -14,6 +14,7 @@
 #include "glue.h"
 #include "hypercalls.h"
 #include "memory.h"
+#include "rewind.h"
 #include "vera/sdcard.h"
 #include "vera/vera_video.h"
 
@@ -376,6 +377,76 @@ BOXMON_COMMAND(dump, "dump")
 	return true;
 }
 
+BOXMON_COMMAND(savestate, "savestate <file>")
+{
+	if (help) {
+		boxmon_console_printf("Save a snapshot of the whole machine to a file, which can later be restored with loadstate.");
+		return true;
+	}
+
+	std::string path_string;
+	if (!parser.parse_string(path_string, input)) {
+		return false;
+	}
+
+	if (machine_save_state_file(path_string.c_str())) {
+		boxmon_console_printf("Saved state to %s", path_string.c_str());
+	} else {
+		boxmon_warning_printf("Could not save state to %s", path_string.c_str());
+	}
+	return true;
+}
+
+BOXMON_COMMAND(loadstate, "loadstate <file>")
+{
+	if (help) {
+		boxmon_console_printf("Restore a machine snapshot previously written by savestate.");
+		return true;
+	}
+
+	std::string path_string;
+	if (!parser.parse_string(path_string, input)) {
+		return false;
+	}
+
+	if (machine_load_state_file(path_string.c_str())) {
+		boxmon_console_printf("Loaded state from %s", path_string.c_str());
+	} else {
+		boxmon_warning_printf("Could not load state from %s", path_string.c_str());
+	}
+	return true;
+}
+
+BOXMON_COMMAND(rewind, "rewind [frames]")
+{
+	if (help) {
+		boxmon_console_printf("Step the machine back to the start of an earlier frame. If omitted, the default is 1 frame.");
+		boxmon_console_printf("Requires the emulator to have been started with -rewind.");
+		return true;
+	}
+
+	if (!rewind_is_enabled()) {
+		boxmon_warning_printf("Rewind is disabled, start the emulator with -rewind <seconds> to enable it");
+		return true;
+	}
+
+	int frames = 1;
+	parser.parse_dec_number(frames, input);
+
+	const uint32_t available = rewind_available_frames();
+	if (frames < 0 || static_cast<uint32_t>(frames) > available) {
+		boxmon_warning_printf("Can only rewind up to %u frames", available);
+		return true;
+	}
+
+	if (rewind_step_back(static_cast<uint32_t>(frames))) {
+		boxmon_console_printf("Rewound %d frames", frames);
+	} else {
+		boxmon_warning_printf("Could not rewind");
+	}
+	return true;
+}
+
 BOXMON_COMMAND(goto, "goto <address>")
 {
 	if (help) {
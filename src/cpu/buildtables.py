@@ -50,6 +50,7 @@ TOTAL_NUMBER_OPCODES = 2 ** 8
 #####################################
 ############# FILENAMES #############
 TABLES_HEADER_FNAME = "tables.h"
+DISPATCH_HEADER_FNAME = "dispatch.h"
 MNEMONICS_DISASSEM_HEADER_FNAME = "mnemonics.h"
 OPCODES_6502_FNAME = "6502.opcodes"
 OPCODES_65c02_FNAME = "65c02.opcodes"
@@ -124,6 +125,21 @@ def replace_and(entry):
     else:
         return entry
 
+#######################################################################################################################
+##############################################  Output fused switch cases  ############################################
+#######################################################################################################################
+def generateDispatch(hFileName):
+    # Operations that can work on either memory or the accumulator are told which one at compile time,
+    # rather than checking addrtable[opcode] on every access.
+    accumulatorOps = set(op[ACTN_KEY_STR] for op in opcodesList if op[MODE_KEY_STR] == "acc")
+
+    hFileName.write("\n// Included inside switch (opcode) as an alternative to dispatching through addrtable and optable.\n")
+    for opInfo in opcodesList:
+        action = replace_and(opInfo[ACTN_KEY_STR])
+        if opInfo[ACTN_KEY_STR] in accumulatorOps:
+            action += "<value_source::accumulator>" if opInfo[MODE_KEY_STR] == "acc" else "<value_source::memory>"
+        hFileName.write("case 0x{0:02X}: {1}(); {2}(); break;\n".format(opInfo[OPCODE_KEY_STR], opInfo[MODE_KEY_STR], action))
+
 #######################################################################################################################
 ###################################################  Output a list   ##################################################
 #######################################################################################################################
@@ -215,6 +231,11 @@ if __name__ == '__main__':
         generateTable(output_h_file, ACTN_CODE_HEADER, ACTN_KEY_STR)
         generateTable(output_h_file, MCHN_CYCLES_HEADER, CYCLES_KEY_STR)
 
+    # Create "DISPATCH_HEADER_FNAME" header file
+    with open(DISPATCH_HEADER_FNAME, "w") as output_h_file:
+        output_h_file.write("/* Generated by buildtables.py */\n")
+        generateDispatch(output_h_file)
+
     # Create disassembly "MNEMONICS_DISASSEM_HEADER_FNAME" header file.
     mnemonics = [convertMnemonic(opcodesList[x]) for x in range(0, TOTAL_NUMBER_OPCODES)]
     mnemonics_mode = [convertMnemonicMode(opcodesList[x]) for x in range(0, TOTAL_NUMBER_OPCODES)]
@@ -0,0 +1,259 @@
+/* Generated by buildtables.py */
+
+// Included inside switch (opcode) as an alternative to dispatching through addrtable and optable.
+case 0x00: imp(); brk(); break;
+case 0x01: indx(); ora(); break;
+case 0x02: imp(); nop(); break;
+case 0x03: imp(); nop(); break;
+case 0x04: zp(); tsb(); break;
+case 0x05: zp(); ora(); break;
+case 0x06: zp(); asl<value_source::memory>(); break;
+case 0x07: zp(); rmb0(); break;
+case 0x08: imp(); php(); break;
+case 0x09: imm(); ora(); break;
+case 0x0A: acc(); asl<value_source::accumulator>(); break;
+case 0x0B: imp(); nop(); break;
+case 0x0C: abso(); tsb(); break;
+case 0x0D: abso(); ora(); break;
+case 0x0E: abso(); asl<value_source::memory>(); break;
+case 0x0F: zprel(); bbr0(); break;
+case 0x10: rel(); bpl(); break;
+case 0x11: indy(); ora(); break;
+case 0x12: ind0(); ora(); break;
+case 0x13: imp(); nop(); break;
+case 0x14: zp(); trb(); break;
+case 0x15: zpx(); ora(); break;
+case 0x16: zpx(); asl<value_source::memory>(); break;
+case 0x17: zp(); rmb1(); break;
+case 0x18: imp(); clc(); break;
+case 0x19: absy(); ora(); break;
+case 0x1A: acc(); inc<value_source::accumulator>(); break;
+case 0x1B: imp(); nop(); break;
+case 0x1C: abso(); trb(); break;
+case 0x1D: absx(); ora(); break;
+case 0x1E: absx(); asl<value_source::memory>(); break;
+case 0x1F: zprel(); bbr1(); break;
+case 0x20: abso(); jsr(); break;
+case 0x21: indx(); and_op(); break;
+case 0x22: imp(); nop(); break;
+case 0x23: imp(); nop(); break;
+case 0x24: zp(); bit(); break;
+case 0x25: zp(); and_op(); break;
+case 0x26: zp(); rol<value_source::memory>(); break;
+case 0x27: zp(); rmb2(); break;
+case 0x28: imp(); plp(); break;
+case 0x29: imm(); and_op(); break;
+case 0x2A: acc(); rol<value_source::accumulator>(); break;
+case 0x2B: imp(); nop(); break;
+case 0x2C: abso(); bit(); break;
+case 0x2D: abso(); and_op(); break;
+case 0x2E: abso(); rol<value_source::memory>(); break;
+case 0x2F: zprel(); bbr2(); break;
+case 0x30: rel(); bmi(); break;
+case 0x31: indy(); and_op(); break;
+case 0x32: ind0(); and_op(); break;
+case 0x33: imp(); nop(); break;
+case 0x34: zpx(); bit(); break;
+case 0x35: zpx(); and_op(); break;
+case 0x36: zpx(); rol<value_source::memory>(); break;
+case 0x37: zp(); rmb3(); break;
+case 0x38: imp(); sec(); break;
+case 0x39: absy(); and_op(); break;
+case 0x3A: acc(); dec<value_source::accumulator>(); break;
+case 0x3B: imp(); nop(); break;
+case 0x3C: absx(); bit(); break;
+case 0x3D: absx(); and_op(); break;
+case 0x3E: absx(); rol<value_source::memory>(); break;
+case 0x3F: zprel(); bbr3(); break;
+case 0x40: imp(); rti(); break;
+case 0x41: indx(); eor(); break;
+case 0x42: imp(); nop(); break;
+case 0x43: imp(); nop(); break;
+case 0x44: imp(); nop(); break;
+case 0x45: zp(); eor(); break;
+case 0x46: zp(); lsr<value_source::memory>(); break;
+case 0x47: zp(); rmb4(); break;
+case 0x48: imp(); pha(); break;
+case 0x49: imm(); eor(); break;
+case 0x4A: acc(); lsr<value_source::accumulator>(); break;
+case 0x4B: imp(); nop(); break;
+case 0x4C: abso(); jmp(); break;
+case 0x4D: abso(); eor(); break;
+case 0x4E: abso(); lsr<value_source::memory>(); break;
+case 0x4F: zprel(); bbr4(); break;
+case 0x50: rel(); bvc(); break;
+case 0x51: indy(); eor(); break;
+case 0x52: ind0(); eor(); break;
+case 0x53: imp(); nop(); break;
+case 0x54: imp(); nop(); break;
+case 0x55: zpx(); eor(); break;
+case 0x56: zpx(); lsr<value_source::memory>(); break;
+case 0x57: zp(); rmb5(); break;
+case 0x58: imp(); cli(); break;
+case 0x59: absy(); eor(); break;
+case 0x5A: imp(); phy(); break;
+case 0x5B: imp(); nop(); break;
+case 0x5C: imp(); nop(); break;
+case 0x5D: absx(); eor(); break;
+case 0x5E: absx(); lsr<value_source::memory>(); break;
+case 0x5F: zprel(); bbr5(); break;
+case 0x60: imp(); rts(); break;
+case 0x61: indx(); adc(); break;
+case 0x62: imp(); nop(); break;
+case 0x63: imp(); nop(); break;
+case 0x64: zp(); stz(); break;
+case 0x65: zp(); adc(); break;
+case 0x66: zp(); ror<value_source::memory>(); break;
+case 0x67: zp(); rmb6(); break;
+case 0x68: imp(); pla(); break;
+case 0x69: imm(); adc(); break;
+case 0x6A: acc(); ror<value_source::accumulator>(); break;
+case 0x6B: imp(); nop(); break;
+case 0x6C: ind(); jmp(); break;
+case 0x6D: abso(); adc(); break;
+case 0x6E: abso(); ror<value_source::memory>(); break;
+case 0x6F: zprel(); bbr6(); break;
+case 0x70: rel(); bvs(); break;
+case 0x71: indy(); adc(); break;
+case 0x72: ind0(); adc(); break;
+case 0x73: imp(); nop(); break;
+case 0x74: zpx(); stz(); break;
+case 0x75: zpx(); adc(); break;
+case 0x76: zpx(); ror<value_source::memory>(); break;
+case 0x77: zp(); rmb7(); break;
+case 0x78: imp(); sei(); break;
+case 0x79: absy(); adc(); break;
+case 0x7A: imp(); ply(); break;
+case 0x7B: imp(); nop(); break;
+case 0x7C: ainx(); jmp(); break;
+case 0x7D: absx(); adc(); break;
+case 0x7E: absx(); ror<value_source::memory>(); break;
+case 0x7F: zprel(); bbr7(); break;
+case 0x80: rel(); bra(); break;
+case 0x81: indx(); sta(); break;
+case 0x82: imp(); nop(); break;
+case 0x83: imp(); nop(); break;
+case 0x84: zp(); sty(); break;
+case 0x85: zp(); sta(); break;
+case 0x86: zp(); stx(); break;
+case 0x87: zp(); smb0(); break;
+case 0x88: imp(); dey(); break;
+case 0x89: imm(); bit(); break;
+case 0x8A: imp(); txa(); break;
+case 0x8B: imp(); nop(); break;
+case 0x8C: abso(); sty(); break;
+case 0x8D: abso(); sta(); break;
+case 0x8E: abso(); stx(); break;
+case 0x8F: zprel(); bbs0(); break;
+case 0x90: rel(); bcc(); break;
+case 0x91: indy(); sta(); break;
+case 0x92: ind0(); sta(); break;
+case 0x93: imp(); nop(); break;
+case 0x94: zpx(); sty(); break;
+case 0x95: zpx(); sta(); break;
+case 0x96: zpy(); stx(); break;
+case 0x97: zp(); smb1(); break;
+case 0x98: imp(); tya(); break;
+case 0x99: absy(); sta(); break;
+case 0x9A: imp(); txs(); break;
+case 0x9B: imp(); nop(); break;
+case 0x9C: abso(); stz(); break;
+case 0x9D: absx(); sta(); break;
+case 0x9E: absx(); stz(); break;
+case 0x9F: zprel(); bbs1(); break;
+case 0xA0: imm(); ldy(); break;
+case 0xA1: indx(); lda(); break;
+case 0xA2: imm(); ldx(); break;
+case 0xA3: imp(); nop(); break;
+case 0xA4: zp(); ldy(); break;
+case 0xA5: zp(); lda(); break;
+case 0xA6: zp(); ldx(); break;
+case 0xA7: zp(); smb2(); break;
+case 0xA8: imp(); tay(); break;
+case 0xA9: imm(); lda(); break;
+case 0xAA: imp(); tax(); break;
+case 0xAB: imp(); nop(); break;
+case 0xAC: abso(); ldy(); break;
+case 0xAD: abso(); lda(); break;
+case 0xAE: abso(); ldx(); break;
+case 0xAF: zprel(); bbs2(); break;
+case 0xB0: rel(); bcs(); break;
+case 0xB1: indy(); lda(); break;
+case 0xB2: ind0(); lda(); break;
+case 0xB3: imp(); nop(); break;
+case 0xB4: zpx(); ldy(); break;
+case 0xB5: zpx(); lda(); break;
+case 0xB6: zpy(); ldx(); break;
+case 0xB7: zp(); smb3(); break;
+case 0xB8: imp(); clv(); break;
+case 0xB9: absy(); lda(); break;
+case 0xBA: imp(); tsx(); break;
+case 0xBB: imp(); nop(); break;
+case 0xBC: absx(); ldy(); break;
+case 0xBD: absx(); lda(); break;
+case 0xBE: absy(); ldx(); break;
+case 0xBF: zprel(); bbs3(); break;
+case 0xC0: imm(); cpy(); break;
+case 0xC1: indx(); cmp(); break;
+case 0xC2: imp(); nop(); break;
+case 0xC3: imp(); nop(); break;
+case 0xC4: zp(); cpy(); break;
+case 0xC5: zp(); cmp(); break;
+case 0xC6: zp(); dec<value_source::memory>(); break;
+case 0xC7: zp(); smb4(); break;
+case 0xC8: imp(); iny(); break;
+case 0xC9: imm(); cmp(); break;
+case 0xCA: imp(); dex(); break;
+case 0xCB: imp(); wai(); break;
+case 0xCC: abso(); cpy(); break;
+case 0xCD: abso(); cmp(); break;
+case 0xCE: abso(); dec<value_source::memory>(); break;
+case 0xCF: zprel(); bbs4(); break;
+case 0xD0: rel(); bne(); break;
+case 0xD1: indy(); cmp(); break;
+case 0xD2: ind0(); cmp(); break;
+case 0xD3: imp(); nop(); break;
+case 0xD4: imp(); nop(); break;
+case 0xD5: zpx(); cmp(); break;
+case 0xD6: zpx(); dec<value_source::memory>(); break;
+case 0xD7: zp(); smb5(); break;
+case 0xD8: imp(); cld(); break;
+case 0xD9: absy(); cmp(); break;
+case 0xDA: imp(); phx(); break;
+case 0xDB: imp(); dbg(); break;
+case 0xDC: imp(); nop(); break;
+case 0xDD: absx(); cmp(); break;
+case 0xDE: absx(); dec<value_source::memory>(); break;
+case 0xDF: zprel(); bbs5(); break;
+case 0xE0: imm(); cpx(); break;
+case 0xE1: indx(); sbc(); break;
+case 0xE2: imp(); nop(); break;
+case 0xE3: imp(); nop(); break;
+case 0xE4: zp(); cpx(); break;
+case 0xE5: zp(); sbc(); break;
+case 0xE6: zp(); inc<value_source::memory>(); break;
+case 0xE7: zp(); smb6(); break;
+case 0xE8: imp(); inx(); break;
+case 0xE9: imm(); sbc(); break;
+case 0xEA: imp(); nop(); break;
+case 0xEB: imp(); nop(); break;
+case 0xEC: abso(); cpx(); break;
+case 0xED: abso(); sbc(); break;
+case 0xEE: abso(); inc<value_source::memory>(); break;
+case 0xEF: zprel(); bbs6(); break;
+case 0xF0: rel(); beq(); break;
+case 0xF1: indy(); sbc(); break;
+case 0xF2: ind0(); sbc(); break;
+case 0xF3: imp(); nop(); break;
+case 0xF4: imp(); nop(); break;
+case 0xF5: zpx(); sbc(); break;
+case 0xF6: zpx(); inc<value_source::memory>(); break;
+case 0xF7: zp(); smb7(); break;
+case 0xF8: imp(); sed(); break;
+case 0xF9: absy(); sbc(); break;
+case 0xFA: imp(); plx(); break;
+case 0xFB: imp(); nop(); break;
+case 0xFC: imp(); nop(); break;
+case 0xFD: absx(); sbc(); break;
+case 0xFE: absx(); inc<value_source::memory>(); break;
+case 0xFF: zprel(); bbs7(); break;
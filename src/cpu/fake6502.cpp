@@ -40,7 +40,9 @@
  *                                                   *
  * void exec6502(uint32_t tickcount)                 *
  *   - Execute 6502 code up to the next specified    *
- *     count of clock ticks.                         *
+ *     count of clock ticks. Returns early after an  *
+ *     instruction that set yield6502, left PC at or *
+ *     above yieldpc6502, or executed WAI.           *
  *                                                   *
  * void step6502()                                   *
  *   - Execute a single instrution.                  *
@@ -51,6 +53,9 @@
  * void nmi6502()                                    *
  *   - Trigger an NMI in the 6502 core.              *
  *                                                   *
+ * void save_restore6502(savestate &state)           *
+ *   - Save or restore registers and cycle count.    *
+ *                                                   *
  *****************************************************
  * Useful variables in this emulator:                *
  *                                                   *
@@ -67,6 +72,7 @@
 #include "fake6502.h"
 
 #include "../debugger.h"
+#include "../savestate.h"
 #include <functional>
 #include <ring_buffer.h>
 #include <stdint.h>
@@ -87,12 +93,17 @@
 _state6502 state6502;
 _state6502 debug_state6502;
 
+// Define to dispatch opcodes through addrtable/optable instead of the generated switch in dispatch.h.
+// #define FAKE6502_TABLE_DISPATCH
+
 // helper variables
 uint32_t instructions   = 0; // keep track of total instructions executed
 uint64_t clockticks6502 = 0, clockgoal6502 = 0;
 uint16_t oldpc, ea, reladdr, value, result;
 uint8_t  opcode, oldstatus;
 uint8_t  debug6502 = 0;
+bool     yield6502   = false;
+uint16_t yieldpc6502 = 0xffff;
 
 uint8_t penaltyop, penaltyaddr;
 uint8_t waiting = 0;
@@ -107,32 +118,68 @@ extern void    write6502(uint16_t address, uint8_t value);
 extern uint8_t bank6502(uint16_t address);
 extern void    vp6502(void);
 
+// Where getvalue()/putvalue() find their operand. Only a few read-modify-write ops
+// have an accumulator mode; those default to checking the current opcode's mode.
+enum class value_source {
+	table,
+	memory,
+	accumulator
+};
+
+template <value_source SRC = value_source::memory>
 static uint16_t getvalue();
-static void     putvalue(uint16_t saveval);
+template <value_source SRC = value_source::memory>
+static void putvalue(uint16_t saveval);
 
 #include "instructions_6502.h"
 #include "instructions_65c02.h"
 #include "modes.h"
 #include "tables.h"
 
+template <value_source SRC>
 static uint16_t getvalue()
 {
-	if (addrtable[opcode] == acc)
+	if constexpr (SRC == value_source::accumulator)
+		return ((uint16_t)state6502.a);
+	else if constexpr (SRC == value_source::memory)
+		return ((uint16_t)read6502(ea));
+	else if (addrtable[opcode] == acc)
 		return ((uint16_t)state6502.a);
 	else
 		return ((uint16_t)read6502(ea));
 }
 
+template <value_source SRC>
 static void putvalue(uint16_t saveval)
 {
-	if (addrtable[opcode] == acc)
+	if constexpr (SRC == value_source::accumulator)
+		state6502.a = (uint8_t)(saveval & 0x00FF);
+	else if constexpr (SRC == value_source::memory)
+		write6502(ea, (saveval & 0x00FF));
+	else if (addrtable[opcode] == acc)
 		state6502.a = (uint8_t)(saveval & 0x00FF);
 	else
 		write6502(ea, (saveval & 0x00FF));
 }
 
+static void dispatch6502()
+{
+#if defined(FAKE6502_TABLE_DISPATCH)
+	(*addrtable[opcode])();
+	(*optable[opcode])();
+#else
+	switch (opcode) {
+#	include "dispatch.h"
+	}
+#endif
+}
+
 static void commit_smartstack()
 {
+	// Most instructions don't touch the stack, so skip building the std::function wrapper for them.
+	if (smartstack_operations.count() == 0) {
+		return;
+	}
 	smartstack_operations.for_each([](const std::function<void(void)> &f) {
 		f();
 	});
@@ -186,6 +233,7 @@ void irq6502()
 void exec6502(uint32_t tickcount)
 {
 	debug6502 = 0;
+	yield6502 = false;
 
 	if (waiting) {
 		clockticks6502 += tickcount;
@@ -193,7 +241,7 @@ void exec6502(uint32_t tickcount)
 		return;
 	}
 
-	clockgoal6502 += tickcount;
+	clockgoal6502 = clockticks6502 + tickcount;
 
 	while (clockticks6502 < clockgoal6502) {
 		debug_state6502                     = state6502;
@@ -211,8 +259,7 @@ void exec6502(uint32_t tickcount)
 		penaltyop   = 0;
 		penaltyaddr = 0;
 
-		(*addrtable[opcode])();
-		(*optable[opcode])();
+		dispatch6502();
 
 		if (debug6502 & (DEBUG6502_READ | DEBUG6502_WRITE)) {
 			state6502      = debug_state6502;
@@ -234,6 +281,17 @@ void exec6502(uint32_t tickcount)
 		history.bank   = bank6502(debug_state6502.pc);
 
 		commit_smartstack();
+
+		if (waiting) {
+			// Nothing more happens until an interrupt, so idle out the rest of the batch.
+			if (clockticks6502 < clockgoal6502) {
+				clockticks6502 = clockgoal6502;
+			}
+			break;
+		}
+		if (yield6502 || state6502.pc >= yieldpc6502) {
+			break;
+		}
 	}
 }
 
@@ -262,8 +320,7 @@ void step6502()
 	penaltyop   = 0;
 	penaltyaddr = 0;
 
-	(*addrtable[opcode])();
-	(*optable[opcode])();
+	dispatch6502();
 
 	if (debug6502 & (DEBUG6502_READ | DEBUG6502_WRITE)) {
 		state6502      = debug_state6502;
@@ -304,8 +361,7 @@ void force6502()
 	penaltyop   = 0;
 	penaltyaddr = 0;
 
-	(*addrtable[opcode])();
-	(*optable[opcode])();
+	dispatch6502();
 
 	clockticks6502 += ticktable[opcode];
 	if (penaltyop && penaltyaddr)
@@ -322,6 +378,22 @@ void force6502()
 	commit_smartstack();
 }
 
+void save_restore6502(savestate &state)
+{
+	state.save_restore(state6502);
+	state.save_restore(clockticks6502);
+	state.save_restore(instructions);
+	state.save_restore(waiting);
+
+	if (!state.saving()) {
+		debug_state6502 = state6502;
+		clockgoal6502   = clockticks6502;
+		stack6502.clear();
+		history6502.clear();
+		smartstack_operations.clear();
+	}
+}
+
 //  Fixes from http://6502.org/tutorials/65c02opcodes.html
 //
 //  65C02 Cycle Count differences.
@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 
+class savestate;
+
 #define DEBUG6502_EXEC 0x1
 #define DEBUG6502_READ 0x2
 #define DEBUG6502_WRITE 0x4
@@ -68,7 +70,10 @@ extern void     force6502();
 extern void     exec6502(uint32_t tickcount);
 extern void     nmi6502();
 extern void     irq6502();
+extern void     save_restore6502(savestate &state);
 extern uint64_t clockticks6502;
 extern uint8_t  debug6502;
+extern bool     yield6502;
+extern uint16_t yieldpc6502;
 
 #endif
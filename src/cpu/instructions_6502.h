@@ -74,17 +74,18 @@ and_op()
 	saveaccum(result);
 }
 
+template <value_source SRC = value_source::table>
 static void
 asl()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = value << 1;
 
 	carrycalc(result);
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
 static void
@@ -290,16 +291,17 @@ cpy()
 	signcalc(result);
 }
 
+template <value_source SRC = value_source::table>
 static void
 dec()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = value - 1;
 
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
 static void
@@ -333,16 +335,17 @@ eor()
 	saveaccum(result);
 }
 
+template <value_source SRC = value_source::table>
 static void
 inc()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = value + 1;
 
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
 static void
@@ -418,10 +421,11 @@ ldy()
 	signcalc(state6502.y);
 }
 
+template <value_source SRC = value_source::table>
 static void
 lsr()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = value >> 1;
 
 	if (value & 1)
@@ -431,7 +435,7 @@ lsr()
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
 static void
@@ -502,23 +506,25 @@ plp()
 	state6502.status = pull8(_stack_op_type::pull_op) | FLAG_CONSTANT;
 }
 
+template <value_source SRC = value_source::table>
 static void
 rol()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = (value << 1) | (state6502.status & FLAG_CARRY);
 
 	carrycalc(result);
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
+template <value_source SRC = value_source::table>
 static void
 ror()
 {
-	value  = getvalue();
+	value  = getvalue<SRC>();
 	result = (value >> 1) | ((state6502.status & FLAG_CARRY) << 7);
 
 	if (value & 1)
@@ -528,7 +534,7 @@ ror()
 	zerocalc(result);
 	signcalc(result);
 
-	putvalue(result);
+	putvalue<SRC>(result);
 }
 
 static void
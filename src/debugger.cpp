@@ -82,6 +82,11 @@ static void set_flags(const uint16_t addr, const uint8_t bank, uint8_t flags)
 	Breakpoint_flags[get_offset(addr, bank)] = flags;
 }
 
+static void update_breakpoints_armed()
+{
+	memory_set_breakpoints_armed(!Active_breakpoints.empty());
+}
+
 static bool execution_exited_interrupt()
 {
 	return (Step_interrupt != 0) && (Step_interrupt != (state6502.status & 0x04));
@@ -254,6 +259,12 @@ void debugger_process_cpu()
 	debugger_pause_execution();
 }
 
+bool debugger_is_watching_cpu()
+{
+	// Stepping and armed breakpoints both need to look at the CPU after every instruction.
+	return Debug_mode != DEBUG_RUN || !Active_breakpoints.empty();
+}
+
 void debugger_pause_execution()
 {
 	Debug_mode = DEBUG_PAUSE;
@@ -435,6 +446,7 @@ void debugger_add_breakpoint(uint16_t address, uint8_t bank /* = 0 */, uint8_t f
 	if (Breakpoints.find(new_bp) == Breakpoints.end()) {
 		Breakpoints.insert(new_bp);
 		Active_breakpoints.insert(new_bp);
+		update_breakpoints_armed();
 	}
 }
 
@@ -454,6 +466,7 @@ void debugger_remove_breakpoint(uint16_t address, uint8_t bank /* = 0 */, uint8_
 		breakpoint_type old_bp{ address, bank };
 		Breakpoints.erase(old_bp);
 		Active_breakpoints.erase(old_bp);
+		update_breakpoints_armed();
 
 		const uint32_t offset = get_offset(address, bank);
 		if (auto citer = Breakpoint_conditions.find(offset); citer != Breakpoint_conditions.end()) {
@@ -479,6 +492,7 @@ void debugger_activate_breakpoint(uint16_t address, uint8_t bank /* = 0 */, uint
 	breakpoint_type new_bp{ address, bank };
 	if (Active_breakpoints.find(new_bp) == Active_breakpoints.end()) {
 		Active_breakpoints.insert(new_bp);
+		update_breakpoints_armed();
 	}
 }
 
@@ -495,6 +509,7 @@ void debugger_deactivate_breakpoint(uint16_t address, uint8_t bank /* = 0 */, ui
 	if ((flags & 0x0f) == 0) {
 		breakpoint_type old_bp{ address, bank };
 		Active_breakpoints.erase(old_bp);
+		update_breakpoints_armed();
 	}
 }
 
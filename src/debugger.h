@@ -28,6 +28,7 @@ void debugger_shutdown();
 bool debugger_is_paused();
 
 void debugger_process_cpu();
+bool debugger_is_watching_cpu();
 void debugger_pause_execution();
 void debugger_continue_execution();
 void debugger_step_execution(uint32_t instruction_count = 0);
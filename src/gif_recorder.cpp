@@ -55,10 +55,10 @@ void gif_recorder_shutdown()
 	}
 }
 
-void gif_recorder_update(const uint8_t *image_bytes)
+void gif_recorder_update()
 {
 	if (Gif_record_state > RECORD_GIF_PAUSED) {
-		if (!GifWriteFrame(&Gif_writer, image_bytes, SCREEN_WIDTH, SCREEN_HEIGHT, 2, 8, false)) {
+		if (!GifWriteFrame(&Gif_writer, vera_video_get_framebuffer(), SCREEN_WIDTH, SCREEN_HEIGHT, 2, 8, false)) {
 			// if that failed, stop recording
 			GifEnd(&Gif_writer);
 			Gif_record_state = RECORD_GIF_DISABLED;
@@ -7,7 +7,9 @@
 #define GLUE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <vector>
 
 #include "cpu/fake6502.h"
 #include "options.h"
@@ -40,7 +42,13 @@ extern bool     save_on_exit;
 
 extern void machine_dump(const char *reason);
 extern void machine_reset();
+extern void machine_save_restore(savestate &state);
+extern void machine_save_state(std::vector<uint8_t> &buffer);
+extern bool machine_load_state(const uint8_t *data, size_t size);
+extern bool machine_save_state_file(const char *path);
+extern bool machine_load_state_file(const char *path);
 extern void machine_toggle_warp();
+extern void machine_sync_io();
 extern void init_audio();
 extern void main_shutdown();
 
@@ -102,6 +102,7 @@ static bool set_kernal_status(int s)
 	// everything okay, write the status!
 	if (s >= 0) {
 		RAM[Kernal_status] = static_cast<uint8_t>(s);
+		memory_mark_dirty(Kernal_status, 1);
 	}
 	return true;
 }
@@ -309,14 +310,17 @@ void hypercalls_update()
 				} else {
 					start = start_hi << 8 | start_lo;
 				}
-				uint16_t end = start + (uint16_t)x16read(prg_file, RAM + start, sizeof(uint8_t), 65536 - (int)start);
+				const uint32_t bytes_read = (uint32_t)x16read(prg_file, RAM + start, sizeof(uint8_t), 65536 - (int)start);
+				uint16_t       end        = start + (uint16_t)bytes_read;
 				x16close(prg_file);
 				prg_file = nullptr;
+				memory_mark_dirty(start, bytes_read);
 
 				if (start == 0x0801) {
 					// set start of variables
 					RAM[VARTAB]     = end & 0xff;
 					RAM[VARTAB + 1] = end >> 8;
+					memory_mark_dirty(VARTAB, 2);
 				}
 
 				// Now look for and load symbols, if applicable.
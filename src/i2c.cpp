@@ -9,6 +9,7 @@
 #include "i2c.h"
 #include "ring_buffer.h"
 #include "rtc.h"
+#include "savestate.h"
 #include "smc.h"
 
 #define LOG_LEVEL 0
@@ -32,6 +33,8 @@ static int     count     = 0;
 static uint8_t device;
 static uint8_t offset;
 
+static i2c_port_t old_i2c_port;
+
 uint8_t i2c_read(uint8_t device, uint8_t offset)
 {
 	uint8_t value;
@@ -67,7 +70,6 @@ void i2c_write(uint8_t device, uint8_t offset, uint8_t value)
 
 void i2c_step()
 {
-	static i2c_port_t old_i2c_port;
 	if (old_i2c_port.clk_in != i2c_port.clk_in || old_i2c_port.data_in != i2c_port.data_in) {
 		LOG_PRINT(5, "I2C({:d}) C:{:d} D:{:d}\n", state, i2c_port.clk_in, i2c_port.data_in);
 		if (state == STATE_STOP && i2c_port.clk_in == 0 && i2c_port.data_in == 0) {
@@ -142,3 +144,18 @@ void i2c_step()
 		old_i2c_port = i2c_port;
 	}
 }
+
+void i2c_save_restore(savestate &snapshot)
+{
+	snapshot.save_restore(i2c_port);
+	snapshot.save_restore(old_i2c_port);
+	snapshot.save_restore(state);
+	snapshot.save_restore(read_mode);
+	snapshot.save_restore(value);
+	snapshot.save_restore(count);
+	snapshot.save_restore(device);
+	snapshot.save_restore(offset);
+
+	rtc_save_restore(snapshot);
+	smc_save_restore(snapshot);
+}
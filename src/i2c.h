@@ -18,6 +18,9 @@ typedef struct {
 
 extern i2c_port_t i2c_port;
 
+class savestate;
+
 void i2c_step();
+void i2c_save_restore(savestate &snapshot);
 
 #endif
@@ -0,0 +1,472 @@
+#include "input_replay.h"
+
+#include <SDL.h>
+#include <fmt/format.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "debugger.h"
+#include "files.h"
+#include "glue.h"
+#include "joystick.h"
+#include "keyboard.h"
+#include "options.h"
+
+//
+// A recording is a small header followed by a stream of events. Each event starts
+// with the number of CPU clocks since the previous event as a varint, then a type
+// byte and its payload. Like save states, the header is in host layout.
+//
+
+#define INPUT_REPLAY_MAGIC 0x52493142
+#define INPUT_REPLAY_VERSION 1
+
+// Flush recorded events to disk once this much has been buffered.
+#define INPUT_REPLAY_FLUSH_SIZE 4096
+
+enum class input_replay_event : uint8_t {
+	key,
+	text,
+	mouse_button,
+	mouse_move,
+	mouse_send,
+	joystick,
+	reset,
+	nmi,
+	end
+};
+
+struct input_replay_header {
+	uint32_t magic;
+	uint32_t version;
+	int64_t  time;
+	uint32_t seed;
+	uint32_t num_ram_banks;
+};
+
+static bool Recording = false;
+static bool Playing   = false;
+
+static input_replay_header Header;
+
+static x16file             *Record_file = nullptr;
+static std::vector<uint8_t> Record_buffer;
+static int32_t              Recorded_joysticks[NUM_JOYSTICKS];
+
+static std::vector<uint8_t> Replay_data;
+static size_t               Replay_offset = 0;
+static uint64_t             Event_clock   = 0;
+
+//
+// Recording
+//
+
+static void flush_recording()
+{
+	if (Record_file != nullptr && !Record_buffer.empty()) {
+		x16write(Record_file, Record_buffer.data(), 1, Record_buffer.size());
+		Record_buffer.clear();
+	}
+}
+
+static void write_varint(uint64_t value)
+{
+	while (value >= 0x80) {
+		Record_buffer.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	Record_buffer.push_back((uint8_t)value);
+}
+
+static void write_signed(int64_t value)
+{
+	write_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void write_event(input_replay_event type)
+{
+	write_varint(clockticks6502 - Event_clock);
+	Record_buffer.push_back((uint8_t)type);
+	Event_clock = clockticks6502;
+}
+
+static void end_event()
+{
+	if (Record_buffer.size() >= INPUT_REPLAY_FLUSH_SIZE) {
+		flush_recording();
+	}
+}
+
+//
+// Playback
+//
+
+static bool read_varint(uint64_t &value)
+{
+	value     = 0;
+	int shift = 0;
+	while (Replay_offset < Replay_data.size() && shift < 64) {
+		const uint8_t b = Replay_data[Replay_offset++];
+		value |= (uint64_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0) {
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+static bool read_signed(int64_t &value)
+{
+	uint64_t raw;
+	if (!read_varint(raw)) {
+		return false;
+	}
+	value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+	return true;
+}
+
+static bool read_byte(uint8_t &value)
+{
+	if (Replay_offset >= Replay_data.size()) {
+		return false;
+	}
+	value = Replay_data[Replay_offset++];
+	return true;
+}
+
+// Read the clock stamp of the next event, or stop playback if there isn't one.
+static void next_event()
+{
+	uint64_t delta;
+	if (!read_varint(delta)) {
+		fmt::print("Input replay: recording ended without an end marker at clock {}.\n", clockticks6502);
+		Playing = false;
+		return;
+	}
+	Event_clock += delta;
+}
+
+// Apply the event at Replay_offset. Returns false if playback should stop.
+static bool apply_event()
+{
+	uint8_t type;
+	if (!read_byte(type)) {
+		return false;
+	}
+
+	switch ((input_replay_event)type) {
+		case input_replay_event::key: {
+			uint8_t  down;
+			uint64_t scancode;
+			if (!read_byte(down) || !read_varint(scancode) || scancode >= SDL_NUM_SCANCODES) {
+				return false;
+			}
+			keyboard_add_event(down != 0, (SDL_Scancode)scancode);
+			return true;
+		}
+		case input_replay_event::text: {
+			uint64_t len;
+			if (!read_varint(len) || len > Replay_data.size() - Replay_offset) {
+				return false;
+			}
+			std::string text(reinterpret_cast<const char *>(Replay_data.data() + Replay_offset), (size_t)len);
+			Replay_offset += (size_t)len;
+			keyboard_add_text(text.c_str());
+			return true;
+		}
+		case input_replay_event::mouse_button: {
+			uint8_t button;
+			if (!read_byte(button)) {
+				return false;
+			}
+			if (button & 0x80) {
+				mouse_button_down(button & 0x7f);
+			} else {
+				mouse_button_up(button & 0x7f);
+			}
+			return true;
+		}
+		case input_replay_event::mouse_move: {
+			int64_t x, y;
+			if (!read_signed(x) || !read_signed(y)) {
+				return false;
+			}
+			mouse_move((int)x, (int)y);
+			return true;
+		}
+		case input_replay_event::mouse_send:
+			mouse_send_state();
+			return true;
+		case input_replay_event::joystick: {
+			uint8_t  slot;
+			uint64_t buttons;
+			if (!read_byte(slot) || !read_varint(buttons) || slot >= NUM_JOYSTICKS) {
+				return false;
+			}
+			joystick_replay_slot(slot, (int32_t)buttons - 1);
+			return true;
+		}
+		case input_replay_event::reset:
+			machine_reset();
+			return true;
+		case input_replay_event::nmi:
+			nmi6502();
+			debugger_interrupt();
+			return true;
+		case input_replay_event::end:
+			fmt::print("Input replay: reached the end of the recording at clock {}.\n", clockticks6502);
+			Playing = false;
+			return true;
+		default:
+			return false;
+	}
+}
+
+//
+// Setup
+//
+
+bool input_replay_init()
+{
+	Header.magic         = INPUT_REPLAY_MAGIC;
+	Header.version       = INPUT_REPLAY_VERSION;
+	Header.seed          = (uint32_t)SDL_GetPerformanceCounter();
+	Header.time          = (int64_t)time(nullptr);
+	Header.num_ram_banks = (uint32_t)Options.num_ram_banks;
+
+	if (!Options.replay_path.empty()) {
+		x16file *f = x16open(Options.replay_path.generic_string().c_str(), "rb");
+		if (f == nullptr) {
+			fmt::print("Cannot open input recording {}!\n", Options.replay_path.generic_string());
+			return false;
+		}
+		Replay_data.resize(x16size(f));
+		const size_t read = x16read(f, Replay_data.data(), 1, Replay_data.size());
+		x16close(f);
+
+		input_replay_header header;
+		if (read != Replay_data.size() || read < sizeof(header)) {
+			fmt::print("Cannot read input recording {}!\n", Options.replay_path.generic_string());
+			return false;
+		}
+		memcpy(&header, Replay_data.data(), sizeof(header));
+		if (header.magic != INPUT_REPLAY_MAGIC || header.version != INPUT_REPLAY_VERSION) {
+			fmt::print("Cannot replay {}: not a Box16 input recording, or from an incompatible version.\n", Options.replay_path.generic_string());
+			return false;
+		}
+		if (header.num_ram_banks != (uint32_t)Options.num_ram_banks) {
+			fmt::print("Warning: {} was recorded with {} RAM banks, but {} are configured. Playback will not match.\n", Options.replay_path.generic_string(), header.num_ram_banks, Options.num_ram_banks);
+		}
+
+		Header        = header;
+		Replay_offset = sizeof(header);
+		Playing       = true;
+	} else if (!Options.record_path.empty()) {
+		Record_file = x16open(Options.record_path.generic_string().c_str(), "wb");
+		if (Record_file == nullptr) {
+			fmt::print("Cannot write input recording {}!\n", Options.record_path.generic_string());
+			return false;
+		}
+		x16write(Record_file, &Header, sizeof(Header), 1);
+	}
+	return true;
+}
+
+void input_replay_shutdown()
+{
+	if (Recording) {
+		write_event(input_replay_event::end);
+		Recording = false;
+	}
+	if (Record_file != nullptr) {
+		flush_recording();
+		x16close(Record_file);
+		Record_file = nullptr;
+	}
+	Playing = false;
+	Replay_data.clear();
+}
+
+void input_replay_start()
+{
+	Event_clock = clockticks6502;
+	if (Record_file != nullptr) {
+		Recording = true;
+		for (int i = 0; i < NUM_JOYSTICKS; ++i) {
+			Recorded_joysticks[i] = -1;
+		}
+		joystick_record_slots();
+	} else if (Playing) {
+		next_event();
+	}
+}
+
+bool input_replay_is_recording()
+{
+	return Recording;
+}
+
+bool input_replay_is_playing()
+{
+	return Playing;
+}
+
+uint32_t input_replay_get_seed()
+{
+	return Header.seed;
+}
+
+time_t input_replay_get_time()
+{
+	return (time_t)Header.time;
+}
+
+void input_replay_process()
+{
+	while (Playing && Event_clock <= clockticks6502) {
+		if (!apply_event()) {
+			fmt::print("Input replay: recording is truncated or corrupt, stopping playback at clock {}.\n", clockticks6502);
+			Playing = false;
+			break;
+		}
+		if (Playing) {
+			next_event();
+		}
+	}
+}
+
+//
+// Host inputs
+//
+
+void input_replay_key(bool down, SDL_Scancode scancode)
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::key);
+		Record_buffer.push_back(down ? 1 : 0);
+		write_varint((uint64_t)scancode);
+		end_event();
+	}
+	keyboard_add_event(down, scancode);
+}
+
+void input_replay_text(const char *text)
+{
+	if (Playing || text == nullptr) {
+		return;
+	}
+	if (Recording) {
+		const size_t len = strlen(text);
+		write_event(input_replay_event::text);
+		write_varint(len);
+		Record_buffer.insert(Record_buffer.end(), text, text + len);
+		end_event();
+	}
+	keyboard_add_text(text);
+}
+
+void input_replay_file(const char *path)
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		// Store the contents rather than the path, in case the file changes before playback.
+		x16file *f = x16open(path, "r");
+		if (f == nullptr) {
+			fmt::print("Cannot open text file {}!\n", path);
+			return;
+		}
+		std::string text(x16size(f), '\0');
+		text.resize(x16read(f, text.data(), 1, text.size()));
+		x16close(f);
+		input_replay_text(text.c_str());
+	} else {
+		keyboard_add_file(path);
+	}
+}
+
+void input_replay_mouse_button(int num, bool down)
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::mouse_button);
+		Record_buffer.push_back((uint8_t)(num | (down ? 0x80 : 0)));
+		end_event();
+	}
+	if (down) {
+		mouse_button_down(num);
+	} else {
+		mouse_button_up(num);
+	}
+}
+
+void input_replay_mouse_move(int x, int y)
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::mouse_move);
+		write_signed(x);
+		write_signed(y);
+		end_event();
+	}
+	mouse_move(x, y);
+}
+
+void input_replay_mouse_send()
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::mouse_send);
+		end_event();
+	}
+	mouse_send_state();
+}
+
+void input_replay_reset()
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::reset);
+		end_event();
+	}
+	machine_reset();
+}
+
+void input_replay_nmi()
+{
+	if (Playing) {
+		return;
+	}
+	if (Recording) {
+		write_event(input_replay_event::nmi);
+		end_event();
+	}
+	nmi6502();
+	debugger_interrupt();
+}
+
+void input_replay_joystick(int slot, int32_t buttons)
+{
+	if (!Recording || Recorded_joysticks[slot] == buttons) {
+		return;
+	}
+	Recorded_joysticks[slot] = buttons;
+	write_event(input_replay_event::joystick);
+	Record_buffer.push_back((uint8_t)slot);
+	write_varint((uint64_t)(buttons + 1));
+	end_event();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#if !defined(INPUT_REPLAY_H)
+#	define INPUT_REPLAY_H
+
+#	include <SDL_scancode.h>
+#	include <stdint.h>
+#	include <time.h>
+
+// Opens Options.record_path or Options.replay_path. Must run before memory and RTC init,
+// since it decides the random seed and wall-clock time the machine starts with.
+bool input_replay_init();
+void input_replay_shutdown();
+
+// Begin recording or playback. Inputs before this point (boot tasks and the like) are not recorded.
+void input_replay_start();
+
+bool     input_replay_is_recording();
+bool     input_replay_is_playing();
+uint32_t input_replay_get_seed();
+time_t   input_replay_get_time();
+
+// Feed recorded inputs that are due at the current clockticks6502.
+void input_replay_process();
+
+//
+// Host inputs pass through these on their way to the machine, so they can be
+// recorded. While playing back, they are dropped instead.
+//
+
+void input_replay_key(bool down, SDL_Scancode scancode);
+void input_replay_text(const char *text);
+void input_replay_file(const char *path);
+void input_replay_mouse_button(int num, bool down);
+void input_replay_mouse_move(int x, int y);
+void input_replay_mouse_send();
+void input_replay_reset();
+void input_replay_nmi();
+
+// Record a joystick slot's button mask, or -1 if nothing is plugged into it.
+void input_replay_joystick(int slot, int32_t buttons);
+
+#endif
@@ -4,7 +4,7 @@
 
 #include "audio.h"
 #include "glue.h"
-#include "keyboard.h"
+#include "input_replay.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,13 +13,13 @@ char javascript_text_data[65536];
 
 void j2c_reset()
 {
-	machine_reset();
+	input_replay_reset();
 }
 
 void j2c_paste(char *buffer)
 {
 	if (buffer != nullptr && *buffer != 0) {
-		keyboard_add_text(buffer);
+		input_replay_text(buffer);
 	}
 }
 
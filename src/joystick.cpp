@@ -3,8 +3,13 @@
 #include <SDL.h>
 #include <unordered_map>
 
+#include "input_replay.h"
+
 #define LOG_JOYSTICK(...) // fmt::format(__VA_ARGS__)
 
+// Controllers driven by input replay get instance ids well clear of the ones SDL hands out.
+#define REPLAY_INSTANCE_ID (0x40000000)
+
 struct joystick_info {
 	SDL_GameController *controller;
 	uint16_t            button_mask;
@@ -54,6 +59,11 @@ void joystick_add(int index)
 {
 	LOG_JOYSTICK("joystick_add({:d})\n", index);
 
+	// Playback supplies its own controllers.
+	if (input_replay_is_playing()) {
+		return;
+	}
+
 	if (!SDL_IsGameController(index)) {
 		return;
 	}
@@ -83,12 +93,17 @@ void joystick_add(int index)
 		}
 		Joystick_controllers.try_emplace(instance_id, joystick_info{ controller, 0xffff, 0, slot });
 	}
+	joystick_record_slots();
 }
 
 void joystick_remove(int instance_id)
 {
 	LOG_JOYSTICK("joystick_remove({:d})\n", instance_id);
 
+	if (input_replay_is_playing()) {
+		return;
+	}
+
 	for (int i = 0; i < NUM_JOYSTICKS; ++i) {
 		if (Joystick_slots[i] == instance_id) {
 			Joystick_slots[i] = -1;
@@ -103,6 +118,7 @@ void joystick_remove(int instance_id)
 		SDL_GameControllerClose(controller);
 		Joystick_controllers.erase(instance_id);
 	}
+	joystick_record_slots();
 }
 
 void joystick_slot_remap(int slot, int instance_id)
@@ -145,6 +161,7 @@ void joystick_slot_remap(int slot, int instance_id)
 	if (instance_old_slot != NUM_JOYSTICKS) {
 		Joystick_slots[instance_old_slot] = slot_old_instance_id;
 	}
+	joystick_record_slots();
 }
 
 void joystick_button_down(int instance_id, uint8_t button)
@@ -155,6 +172,7 @@ void joystick_button_down(int instance_id, uint8_t button)
 	if (joy != Joystick_controllers.end()) {
 		joy->second.button_mask &= ~(button_map[button]);
 	}
+	joystick_record_slots();
 }
 
 void joystick_button_up(int instance_id, uint8_t button)
@@ -165,6 +183,36 @@ void joystick_button_up(int instance_id, uint8_t button)
 	if (joy != Joystick_controllers.end()) {
 		joy->second.button_mask |= button_map[button];
 	}
+	joystick_record_slots();
+}
+
+void joystick_record_slots()
+{
+	if (!input_replay_is_recording()) {
+		return;
+	}
+
+	for (int i = 0; i < NUM_JOYSTICKS; ++i) {
+		const auto &joy = Joystick_controllers.find(Joystick_slots[i]);
+		if (Joystick_slots[i] == -1 || joy == Joystick_controllers.end()) {
+			input_replay_joystick(i, -1);
+		} else {
+			input_replay_joystick(i, joy->second.button_mask);
+		}
+	}
+}
+
+void joystick_replay_slot(int slot, int32_t buttons)
+{
+	const int instance_id = REPLAY_INSTANCE_ID + slot;
+	if (buttons < 0) {
+		Joystick_slots[slot] = -1;
+		Joystick_controllers.erase(instance_id);
+	} else {
+		auto joy                = Joystick_controllers.try_emplace(instance_id, joystick_info{ nullptr, 0xffff, 0, slot }).first;
+		joy->second.button_mask = (uint16_t)buttons;
+		Joystick_slots[slot]    = instance_id;
+	}
 }
 
 static void do_shift()
@@ -24,6 +24,12 @@ void joystick_slot_remap(int slot, int instance_id);
 void joystick_button_down(int instance_id, uint8_t button);
 void joystick_button_up(int instance_id, uint8_t button);
 
+// Report every slot's buttons to the input recorder.
+void joystick_record_slots();
+
+// Drive a slot from a recording; buttons < 0 unplugs it.
+void joystick_replay_slot(int slot, int32_t buttons);
+
 void joystick_set_latch(bool value);
 void joystick_set_clock(bool value);
 
@@ -10,6 +10,7 @@
 #include "glue.h"
 #include "keyboard.h"
 #include "i2c.h"
+#include "memory.h"
 #include "ring_buffer.h"
 #include "rom_symbols.h"
 #include "unicode.h"
@@ -119,6 +120,8 @@ static bool process_text_input(text_input_data &data)
 			c      = iso8859_15_from_unicode(c);
 		}
 		if (c && !e) {
+			memory_mark_dirty(KEYD + RAM[NDX], 1);
+			memory_mark_dirty(NDX, 1);
 			RAM[KEYD + RAM[NDX]] = c;
 			RAM[NDX]++;
 		} else {
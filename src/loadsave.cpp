@@ -135,11 +135,13 @@ void LOAD()
 
 	if (kernal_filename[0] == '$') {
 		const uint16_t dir_len = create_directory_listing(RAM + override_start);
+		memory_mark_dirty(override_start, dir_len);
 		const uint16_t end     = override_start + dir_len;
 		state6502.x            = end & 0xff;
 		state6502.y            = end >> 8;
 		state6502.status &= 0xfe;
 		RAM[STATUS] = 0;
+		memory_mark_dirty(STATUS, 1);
 		state6502.a = 0;
 	} else {
 		char      filename[PATH_MAX];
@@ -153,6 +155,7 @@ void LOAD()
 		if (f == nullptr) {
 			state6502.a = 4; // FNF
 			RAM[STATUS] = state6502.a;
+			memory_mark_dirty(STATUS, 1);
 			state6502.status |= 1;
 			return;
 		}
@@ -194,13 +197,16 @@ void LOAD()
 		} else if (start < 0x9f00) {
 			// Fixed RAM
 			bytes_read = (uint16_t)x16read(f, RAM + start, sizeof(uint8_t), 0x9f00 - start);
+			memory_mark_dirty(start, bytes_read);
 		} else if (start < 0xa000) {
 			// IO addresses
 		} else if (start < 0xc000) {
 			// banked RAM
 			while (1) {
-				size_t len = 0xc000 - start;
-				bytes_read = (uint16_t)x16read(f, RAM + (((memory_get_ram_bank() % (uint16_t)Options.num_ram_banks) << 13) & 0xffffff) + start, sizeof(uint8_t), static_cast<unsigned int>(len));
+				size_t         len        = 0xc000 - start;
+				const uint32_t bank_start = (((memory_get_ram_bank() % (uint16_t)Options.num_ram_banks) << 13) & 0xffffff) + start;
+				bytes_read                = (uint16_t)x16read(f, RAM + bank_start, sizeof(uint8_t), static_cast<unsigned int>(len));
+				memory_mark_dirty(bank_start, bytes_read);
 				if (bytes_read < len)
 					break;
 
@@ -219,6 +225,7 @@ void LOAD()
 		state6502.y  = end >> 8;
 		state6502.status &= 0xfe;
 		RAM[STATUS] = 0;
+		memory_mark_dirty(STATUS, 1);
 		state6502.a = 0;
 	}
 }
@@ -249,6 +256,7 @@ void SAVE()
 	if (f == nullptr) {
 		state6502.a = 4; // FNF
 		RAM[STATUS] = state6502.a;
+		memory_mark_dirty(STATUS, 1);
 		state6502.status |= 1;
 		return;
 	}
@@ -261,5 +269,6 @@ void SAVE()
 
 	state6502.status &= 0xfe;
 	RAM[STATUS] = 0;
+	memory_mark_dirty(STATUS, 1);
 	state6502.a = 0;
 }
@@ -3,7 +3,9 @@
 // Copyright (c) 2021-2023 Stephen Horn, et al.
 // All rights reserved. License: 2-clause BSD
 
+#include <algorithm>
 #include <limits.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,6 +17,7 @@
 #endif
 #include "SDL.h"
 #include "audio.h"
+#include "benchmark.h"
 #include "boxmon/boxmon.h"
 #include "cpu/fake6502.h"
 #include "cpu/mnemonics.h"
@@ -27,6 +30,7 @@
 #include "hypercalls.h"
 #include "i2c.h"
 #include "ieee.h"
+#include "input_replay.h"
 #include "joystick.h"
 #include "keyboard.h"
 #include "memory.h"
@@ -34,8 +38,11 @@
 #include "options.h"
 #include "overlay/cpu_visualization.h"
 #include "overlay/overlay.h"
+#include "profiler.h"
+#include "rewind.h"
 #include "ring_buffer.h"
 #include "rtc.h"
+#include "savestate.h"
 #include "sdl_events.h"
 #include "serial.h"
 #include "symbols.h"
@@ -64,6 +71,19 @@ bool save_on_exit = true;
 bool   has_boot_tasks = false;
 gzFile prg_file       = nullptr;
 
+// Devices are stepped lazily: after each CPU batch, and before any I/O access inside one.
+static uint64_t Device_clockticks = 0;
+static bool     Device_new_frame  = false;
+static bool     Irq_asserted      = false;
+
+// Set from a signal handler in headless mode, where nothing pumps SDL events.
+static volatile sig_atomic_t Headless_quit_requested = 0;
+
+static void headless_quit_handler(int)
+{
+	Headless_quit_requested = 1;
+}
+
 void machine_dump(const char *reason)
 {
 	fmt::print("Dumping system memory. Reason: {}\n", reason);
@@ -125,6 +145,107 @@ void machine_dump(const char *reason)
 	fmt::print("Dumped system to .\n", filename);
 }
 
+// Snapshot header: "B16S", format version, RAM bank count. Bump the version whenever any
+// module's save_restore changes what it stores.
+#define SAVESTATE_MAGIC 0x53363142
+#define SAVESTATE_VERSION 4
+
+void machine_save_restore(savestate &state)
+{
+	save_restore6502(state);
+	memory_save_restore(state);
+	vera_video_save_restore(state);
+	vera_spi_save_restore(state);
+	via_save_restore(state);
+	i2c_save_restore(state);
+	YM_save_restore(state);
+
+	if (!state.saving()) {
+		Device_clockticks = clockticks6502;
+		Device_new_frame  = false;
+		Irq_asserted      = false;
+		YM_clear_backbuffer();
+	}
+}
+
+void machine_save_state(std::vector<uint8_t> &buffer)
+{
+	buffer.clear();
+
+	savestate state(buffer);
+	uint32_t  magic     = SAVESTATE_MAGIC;
+	uint32_t  version   = SAVESTATE_VERSION;
+	uint16_t  num_banks = Options.num_ram_banks;
+	state.save_restore(magic);
+	state.save_restore(version);
+	state.save_restore(num_banks);
+
+	machine_save_restore(state);
+}
+
+bool machine_load_state(const uint8_t *data, size_t size)
+{
+	savestate state(data, size);
+	uint32_t  magic     = 0;
+	uint32_t  version   = 0;
+	uint16_t  num_banks = 0;
+	state.save_restore(magic);
+	state.save_restore(version);
+	state.save_restore(num_banks);
+	if (magic != SAVESTATE_MAGIC || version != SAVESTATE_VERSION) {
+		fmt::print("Cannot load state: not a Box16 save state, or from an incompatible version.\n");
+		return false;
+	}
+	if (num_banks != Options.num_ram_banks) {
+		fmt::print("Cannot load state: it was saved with {} RAM banks, but {} are configured.\n", num_banks, Options.num_ram_banks);
+		return false;
+	}
+
+	machine_save_restore(state);
+	if (state.failed() || !state.finished()) {
+		// Some modules have already been overwritten, so there is no consistent machine to go back to.
+		fmt::print("Cannot load state: data is truncated or corrupt. Resetting machine.\n");
+		machine_reset();
+		rewind_reset();
+		return false;
+	}
+
+	rewind_reset();
+	return true;
+}
+
+bool machine_save_state_file(const char *path)
+{
+	std::vector<uint8_t> buffer;
+	machine_save_state(buffer);
+
+	x16file *f = x16open(path, "wb");
+	if (f == nullptr) {
+		fmt::print("Cannot write save state to {}!\n", path);
+		return false;
+	}
+	const size_t written = x16write(f, buffer.data(), 1, buffer.size());
+	x16close(f);
+	return written == buffer.size();
+}
+
+bool machine_load_state_file(const char *path)
+{
+	x16file *f = x16open(path, "rb");
+	if (f == nullptr) {
+		fmt::print("Cannot open save state {}!\n", path);
+		return false;
+	}
+	std::vector<uint8_t> buffer(x16size(f));
+	const size_t         read = x16read(f, buffer.data(), 1, buffer.size());
+	x16close(f);
+	if (read != buffer.size()) {
+		fmt::print("Cannot read save state {}!\n", path);
+		return false;
+	}
+	return machine_load_state(buffer.data(), buffer.size());
+}
+
 void machine_reset()
 {
 	memory_reset();
@@ -149,6 +270,62 @@ void machine_toggle_warp()
 	}
 }
 
+static void machine_step_devices()
+{
+	const uint32_t clocks = (uint32_t)(clockticks6502 - Device_clockticks);
+	if (clocks == 0) {
+		return;
+	}
+	Device_clockticks = clockticks6502;
+
+	{
+		profiler_scope scope(profiler_section::video);
+		Device_new_frame |= vera_video_step(MHZ, clocks);
+	}
+	{
+		profiler_scope scope(profiler_section::devices);
+		via1_step(clocks);
+		via2_step(clocks);
+		rtc_step(clocks);
+		if (Options.enable_serial) {
+			serial_step(clocks);
+		}
+	}
+	{
+		profiler_scope scope(profiler_section::audio);
+		audio_render(clocks);
+	}
+}
+
+void machine_sync_io()
+{
+	// Bring devices up to the start of the current instruction, then end the batch after it,
+	// since the access may have changed an IRQ or the next device deadline.
+	machine_step_devices();
+	yield6502 = true;
+}
+
+static bool machine_must_single_step()
+{
+#if defined(TRACE)
+	return true;
+#else
+	return Irq_asserted || Options.enable_serial || debugger_is_watching_cpu() || cpu_visualization_is_enabled();
+#endif
+}
+
+static uint32_t machine_clocks_until_event()
+{
+	uint32_t clocks = vera_video_clocks_until_next_event(MHZ);
+	clocks          = std::min(clocks, via1_clocks_until_irq());
+	clocks          = std::min(clocks, via2_clocks_until_irq());
+	clocks          = std::min(clocks, (uint32_t)audio_clocks_until_next_buffer());
+	if (YM_irq_is_enabled()) {
+		clocks = std::min(clocks, YM_clocks_until_next_sample());
+	}
+	return clocks;
+}
+
 static bool is_kernal()
 {
 	// only for KERNAL
@@ -180,12 +357,22 @@ int main(int argc, char **argv)
 		vera_video_set_cheat_mask((1 << (Options.warp_factor - 1)) - 1);
 	}
 
+	if (!input_replay_init()) {
+		exit(1);
+	}
+
+	if (!profiler_init()) {
+		exit(1);
+	}
+
 	// Initialize memory
 	{
 		memory_init_params memory_params;
 		memory_params.randomize                           = Options.memory_randomize;
 		memory_params.enable_uninitialized_access_warning = Options.memory_uninit_warn;
+		memory_params.enable_memory_stats                 = Options.dump_memstats;
 		memory_params.num_banks                           = Options.num_ram_banks;
+		memory_params.random_seed                         = input_replay_get_seed();
 
 		memory_init(memory_params);
 	}
@@ -219,7 +406,11 @@ int main(int argc, char **argv)
 		vsprintf(message_buffer, format, list);
 		va_end(list);
 
-		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, title, message_buffer, display_get_window());
+		if (Options.headless) {
+			fmt::print("{}: {}\n", title, message_buffer);
+		} else {
+			SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, title, message_buffer, display_get_window());
+		}
 		exit(1);
 	};
 
@@ -230,7 +421,11 @@ int main(int argc, char **argv)
 		vsprintf(message_buffer, format, list);
 		va_end(list);
 
-		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, title, message_buffer, display_get_window());
+		if (Options.headless) {
+			fmt::print("{}: {}\n", title, message_buffer);
+		} else {
+			SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, title, message_buffer, display_get_window());
+		}
 	};
 
 	// Load ROM
@@ -300,17 +495,28 @@ int main(int argc, char **argv)
 	SDL_SetHint(SDL_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR, "0");
 #endif
 
-	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO);
+	if (Options.headless) {
+		// SIGINT and SIGTERM set a flag instead of queueing an SDL event, so the loop never has to pump events.
+		SDL_SetHint(SDL_HINT_NO_SIGNAL_HANDLERS, "1");
+		SDL_Init(SDL_INIT_EVENTS);
+		signal(SIGINT, headless_quit_handler);
+		signal(SIGTERM, headless_quit_handler);
+	} else {
+		SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_GAMECONTROLLER | SDL_INIT_AUDIO);
+	}
 
 	if (!Options.no_sound) {
 		audio_init(Options.audio_dev_name.size() > 0 ? Options.audio_dev_name.c_str() : nullptr, Options.audio_buffers);
 		audio_set_render_callback(wav_recorder_process);
 		YM_set_irq_enabled(Options.ym_irq);
 		YM_set_strict_busy(Options.ym_strict);
+	} else if (!Options.benchmark.empty()) {
+		// No device to play to, but render anyway so that audio shows up in the results.
+		audio_init_offline();
 	}
 
 	// Initialize display
-	{
+	if (!Options.headless) {
 		const bool initd = display_init();
 		if (initd == false) {
 			fmt::print("Could not initialize display, quitting.\n");
@@ -321,6 +527,7 @@ int main(int argc, char **argv)
 	}
 
 	vera_video_reset();
+	vera_video_set_render_thread(Options.render_thread);
 
 	if (!Options.gif_path.empty()) {
 		gif_recorder_set_path(Options.gif_path.generic_string().c_str());
@@ -356,15 +563,32 @@ int main(int argc, char **argv)
 	gif_recorder_init(SCREEN_WIDTH, SCREEN_HEIGHT);
 	wav_recorder_init();
 
-	joystick_init();
+	if (!Options.headless) {
+		joystick_init();
+	}
 
 	midi_init();
 
-	rtc_init(Options.set_system_time);
+	rtc_init(Options.set_system_time, input_replay_get_time());
 
 	machine_reset();
 
+	rewind_init(Options.rewind_seconds * 60);
+
+	if (!Options.loadstate_path.empty()) {
+		machine_load_state_file(Options.loadstate_path.generic_string().c_str());
+	}
+
 	timing_init();
+	input_replay_start();
+
+	if (!Options.benchmark.empty() && !benchmark_start()) {
+		main_shutdown();
+		return 1;
+	}
+
+	// hypercalls_process() and the $FFFF exit check both need to see these addresses between instructions.
+	yieldpc6502 = 0xfeb1;
 
 #ifdef __EMSCRIPTEN__
 	emscripten_set_main_loop(emulator_loop, 0, 1);
@@ -394,12 +618,18 @@ void main_shutdown() {
 	}
 
 	boxmon_system_shutdown();
+	input_replay_shutdown();
+	profiler_shutdown();
+	rewind_shutdown();
 	sdcard_shutdown();
+	vera_video_set_render_thread(false);
 	audio_close();
 	wav_recorder_shutdown();
 	gif_recorder_shutdown();
 	debugger_shutdown();
-	display_shutdown();
+	if (!Options.headless) {
+		display_shutdown();
+	}
 	SDL_Quit();
 }
 
@@ -407,12 +637,27 @@ void emulator_loop()
 {
 	for (;;) {
 		if (debugger_is_paused()) {
+			if (Options.headless) {
+				// Nothing can resume us without the UI, so idle until asked to quit.
+				if (Headless_quit_requested) {
+					break;
+				}
+				SDL_Delay(16);
+				continue;
+			}
 			vera_video_force_redraw_screen();
-			display_process();
+			{
+				profiler_scope scope(profiler_section::display);
+				display_process();
+			}
+			input_replay_process();
 			if (!sdl_events_update()) {
 				break;
 			}
-			timing_update();
+			{
+				profiler_scope scope(profiler_section::idle);
+				timing_update();
+			}
 			continue;
 		}
 
@@ -459,8 +704,11 @@ void emulator_loop()
 		}
 #endif
 
-		uint64_t old_clockticks6502 = clockticks6502;
-		step6502();
+		if (machine_must_single_step()) {
+			step6502();
+		} else {
+			exec6502(machine_clocks_until_event());
+		}
 		if (debug6502) {
 			debugger_process_cpu();
 			if (debugger_is_paused()) {
@@ -470,37 +718,53 @@ void emulator_loop()
 			}
 		}
 		cpu_visualization_step();
-		uint8_t clocks       = (uint8_t)(clockticks6502 - old_clockticks6502);
-		bool    new_frame    = vera_video_step(MHZ, clocks);
-		via1_step(clocks);
-		via2_step(clocks);
-		rtc_step(clocks);
-		if (Options.enable_serial) {
-			serial_step(clocks);
-		}
-		audio_render(clocks);
+		machine_step_devices();
 
-		if (new_frame) {
-			midi_process();
-			gif_recorder_update(vera_video_get_framebuffer());
-			static uint32_t last_display_us = timing_total_microseconds_realtime();
-			const uint32_t  display_us      = timing_total_microseconds_realtime();
-			if ((Options.warp_factor == 0) || (display_us - last_display_us > 16000)) { // Close enough I'm willing to pay for OpenGL's sync.
-				display_process();
-				last_display_us = display_us;
+		if (Device_new_frame) {
+			Device_new_frame = false;
+			profiler_end_frame();
+			if (!benchmark_frame()) {
+				break;
 			}
-			if (!sdl_events_update()) {
+
+			bool running = true;
+			{
+				profiler_scope scope(profiler_section::host);
+				rewind_capture_frame();
+				midi_process();
+				gif_recorder_update();
+				input_replay_process();
+				if (Options.headless) {
+					running = !Headless_quit_requested;
+				}
+			}
+			if (!Options.headless) {
+				static uint32_t last_display_us = timing_total_microseconds_realtime();
+				const uint32_t  display_us      = timing_total_microseconds_realtime();
+				if ((Options.warp_factor == 0) || (display_us - last_display_us > 16000)) { // Close enough I'm willing to pay for OpenGL's sync.
+					profiler_scope scope(profiler_section::display);
+					display_process();
+					last_display_us = display_us;
+				}
+				profiler_scope scope(profiler_section::host);
+				running = sdl_events_update();
+			}
+			if (!running) {
 				break;
 			}
 
-			timing_update();
+			{
+				profiler_scope scope(profiler_section::idle);
+				timing_update();
+			}
 #ifdef __EMSCRIPTEN__
 			// After completing a frame we yield back control to the browser to stay responsive
 			return 0;
 #endif
 		}
 
-		if (vera_video_get_irq_out() || YM_irq() || via1_irq() || via2_irq()) {
+		Irq_asserted = vera_video_get_irq_out() || YM_irq() || via1_irq() || via2_irq();
+		if (Irq_asserted) {
 			irq6502();
 			debugger_interrupt();
 		}
@@ -5,6 +5,7 @@
 
 #include "memory.h"
 
+#include <bit>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,6 +19,7 @@
 #include "gif_recorder.h"
 #include "glue.h"
 #include "hypercalls.h"
+#include "savestate.h"
 #include "unicode.h"
 #include "vera/vera_video.h"
 #include "via.h"
@@ -37,11 +39,71 @@ uint8_t rom_bank_register;
 #define RAM_WRITE_BLOCKS (((RAM_SIZE) + 0x3f) >> 6)
 static uint64_t *RAM_written;
 
-static uint64_t *RAM_read_counts;
-static uint64_t *RAM_write_counts;
+//
+// Dirty bitmaps, one bit per 64-byte block written since the last call to
+// memory_take_dirty_blocks(). They let rewind snapshot just what changed, and
+// are only kept while it asks for them, so other writes cost a single test.
+//
+
+#define DIRTY_BLOCK_SHIFT (6)
+#define DIRTY_WORDS(size) (((((size) + MEMORY_DIRTY_BLOCK_SIZE - 1) >> DIRTY_BLOCK_SHIFT) + 0x3f) >> 6)
+
+static uint64_t *RAM_dirty;
+static uint64_t  ROM_dirty[DIRTY_WORDS(ROM_SIZE)];
+static bool      Dirty_tracking = false;
+
+static inline void mark_dirty(uint64_t *dirty, uint32_t offset)
+{
+	if (Dirty_tracking) {
+		const uint32_t block = offset >> DIRTY_BLOCK_SHIFT;
+		dirty[block >> 6] |= (uint64_t)1 << (block & 0x3f);
+	}
+}
+
+//
+// Usage counters are only kept with -memorystats. They saturate at 32 bits and
+// are allocated per 8KB page, the first time something in that page is touched.
+//
+
+#define USAGE_PAGE_SHIFT (13)
+#define USAGE_PAGE_SIZE (1 << USAGE_PAGE_SHIFT)
+
+struct usage_counts {
+	uint32_t **pages     = nullptr;
+	uint32_t   num_pages = 0;
+};
 
-static uint64_t *ROM_read_counts;
-static uint64_t *ROM_write_counts;
+static usage_counts RAM_read_counts;
+static usage_counts RAM_write_counts;
+
+static usage_counts ROM_read_counts;
+static usage_counts ROM_write_counts;
+
+static void usage_init(usage_counts &counts, uint32_t size)
+{
+	counts.num_pages = (size + USAGE_PAGE_SIZE - 1) >> USAGE_PAGE_SHIFT;
+	counts.pages     = new uint32_t *[counts.num_pages];
+	memset(counts.pages, 0, counts.num_pages * sizeof(uint32_t *));
+}
+
+static void usage_count(usage_counts &counts, uint32_t offset)
+{
+	uint32_t *&page = counts.pages[offset >> USAGE_PAGE_SHIFT];
+	if (page == nullptr) {
+		page = new uint32_t[USAGE_PAGE_SIZE];
+		memset(page, 0, USAGE_PAGE_SIZE * sizeof(uint32_t));
+	}
+	uint32_t &count = page[offset & (USAGE_PAGE_SIZE - 1)];
+	if (count != UINT32_MAX) {
+		++count;
+	}
+}
+
+static uint32_t usage_get(const usage_counts &counts, uint32_t offset)
+{
+	const uint32_t *page = counts.pages[offset >> USAGE_PAGE_SHIFT];
+	return page != nullptr ? page[offset & (USAGE_PAGE_SIZE - 1)] : 0;
+}
 
 static uint8_t  addr_ym    = 0;
 static uint64_t clock_snap = 0UL;
@@ -113,6 +175,17 @@ static void build_memory_map(memmap_table_entry *table_entries, uint8_t *map)
 
 static memory_init_params Memory_params;
 
+// When nothing needs to observe individual accesses (no armed breakpoints, no
+// memory stats, no uninitialized access warnings), read6502/write6502 take an
+// unchecked path that skips the breakpoint lookup and usage counters.
+static bool Breakpoints_armed = false;
+static bool Checked_access    = true;
+
+static void update_checked_access()
+{
+	Checked_access = Breakpoints_armed || Memory_params.enable_memory_stats || Memory_params.enable_uninitialized_access_warning;
+}
+
 //
 // Initialization and re-initialization
 //
@@ -123,8 +196,8 @@ void memory_init(const memory_init_params &init_params)
 
 	const uint32_t ram_size = RAM_SIZE;
 	RAM                     = new uint8_t[ram_size];
+	srand(Memory_params.random_seed);
 	if (Memory_params.randomize) {
-		srand((uint32_t)SDL_GetPerformanceCounter());
 		for (uint32_t i = 0; i < ram_size; ++i) {
 			RAM[i] = rand();
 		}
@@ -136,19 +209,21 @@ void memory_init(const memory_init_params &init_params)
 	RAM_written                     = new uint64_t[RAM_WRITE_BLOCKS];
 	memset(RAM_written, 0, RAM_WRITE_BLOCKS * sizeof(uint64_t));
 
-	RAM_read_counts  = new uint64_t[RAM_SIZE];
-	RAM_write_counts = new uint64_t[RAM_SIZE];
-	ROM_read_counts  = new uint64_t[ROM_SIZE];
-	ROM_write_counts = new uint64_t[ROM_SIZE];
+	RAM_dirty = new uint64_t[DIRTY_WORDS(ram_size)];
+	memset(RAM_dirty, 0, DIRTY_WORDS(ram_size) * sizeof(uint64_t));
+	memset(ROM_dirty, 0, sizeof(ROM_dirty));
 
-	memset(RAM_read_counts, 0, RAM_SIZE * sizeof(uint64_t));
-	memset(RAM_write_counts, 0, RAM_SIZE * sizeof(uint64_t));
-	memset(ROM_read_counts, 0, ROM_SIZE * sizeof(uint64_t));
-	memset(ROM_write_counts, 0, ROM_SIZE * sizeof(uint64_t));
+	if (Memory_params.enable_memory_stats) {
+		usage_init(RAM_read_counts, RAM_SIZE);
+		usage_init(RAM_write_counts, RAM_SIZE);
+		usage_init(ROM_read_counts, ROM_SIZE);
+		usage_init(ROM_write_counts, ROM_SIZE);
+	}
 
 	build_memory_map(memmap_table_hi, memory_map_hi);
 	build_memory_map(memmap_table_io, memory_map_io);
 
+	update_checked_access();
 	memory_reset();
 }
 
@@ -159,6 +234,12 @@ void memory_reset()
 	memory_set_rom_bank(0);
 }
 
+void memory_set_breakpoints_armed(bool armed)
+{
+	Breakpoints_armed = armed;
+	update_checked_access();
+}
+
 //
 // Banked RAM access
 //
@@ -180,31 +261,43 @@ static uint8_t debug_ram_read(uint16_t address, uint8_t bank)
 	return RAM[real_address];
 }
 
+template <bool CHECKED>
 static uint8_t real_ram_read(uint16_t address)
 {
 	const int ramBank      = effective_ram_bank();
 	const int real_address = (ramBank << 13) + address;
 
-	if ((RAM_written[real_address >> 6] & ((uint64_t)1 << (real_address & 0x3f))) == 0 && Memory_params.enable_uninitialized_access_warning) {
-		fmt::print("Warning: {:02X}:{:04X} accessed uninitialized RAM address {:02X}:{:04X}\n", bank6502(debug_state6502.pc), debug_state6502.pc, address < 0xa000 ? 0 : ramBank, address);
+	if constexpr (CHECKED) {
+		if ((RAM_written[real_address >> 6] & ((uint64_t)1 << (real_address & 0x3f))) == 0 && Memory_params.enable_uninitialized_access_warning) {
+			fmt::print("Warning: {:02X}:{:04X} accessed uninitialized RAM address {:02X}:{:04X}\n", bank6502(debug_state6502.pc), debug_state6502.pc, address < 0xa000 ? 0 : ramBank, address);
+		}
+		if (Memory_params.enable_memory_stats) {
+			usage_count(RAM_read_counts, real_address);
+		}
 	}
-	++RAM_read_counts[real_address];
 	return RAM[real_address];
 }
 
 static void debug_ram_write(uint16_t address, uint8_t bank, uint8_t value)
 {
-	RAM[((uint32_t)bank << 13) + address] = value;
+	const uint32_t real_address = ((uint32_t)bank << 13) + address;
+	mark_dirty(RAM_dirty, real_address);
+	RAM[real_address] = value;
 }
 
+template <bool CHECKED>
 static void real_ram_write(uint16_t address, uint8_t value)
 {
 	const int ramBank      = effective_ram_bank();
 	const int real_address = (ramBank << 13) + address;
 
-	RAM_written[real_address >> 6] |= (uint64_t)1 << (real_address & 0x3f);
-
-	++RAM_write_counts[real_address];
+	if constexpr (CHECKED) {
+		RAM_written[real_address >> 6] |= (uint64_t)1 << (real_address & 0x3f);
+		if (Memory_params.enable_memory_stats) {
+			usage_count(RAM_write_counts, real_address);
+		}
+	}
+	mark_dirty(RAM_dirty, real_address);
 	RAM[real_address] = value;
 
 	if (address == 1) {
@@ -222,27 +315,40 @@ static uint8_t debug_rom_read(uint16_t address, uint8_t bank)
 	return ROM[(romBank << 14) + address - 0xc000];
 }
 
+template <bool CHECKED>
 static uint8_t real_rom_read(uint16_t address)
 {
 	const int real_address = (ROM_BANK << 14) + address - 0xc000;
-	++ROM_read_counts[real_address];
+	if constexpr (CHECKED) {
+		if (Memory_params.enable_memory_stats) {
+			usage_count(ROM_read_counts, real_address);
+		}
+	}
 	return ROM[real_address];
 }
 
 static void debug_rom_write(uint16_t address, uint8_t bank, uint8_t value)
 {
 	if (bank <= NUM_ROM_BANKS) {
-		ROM[((uint32_t)bank << 14) + address - 0xc000] = value;
+		const uint32_t real_address = ((uint32_t)bank << 14) + address - 0xc000;
+		mark_dirty(ROM_dirty, real_address);
+		ROM[real_address] = value;
 	}
 }
 
+template <bool CHECKED>
 static void real_rom_write(uint16_t address, uint8_t value)
 {
 	const int romBank = effective_rom_bank();
 	if (romBank <= NUM_ROM_BANKS) {
 		const int real_address = (romBank << 14) + address - 0xc000;
 
-		++ROM_write_counts[real_address];
+		if constexpr (CHECKED) {
+			if (Memory_params.enable_memory_stats) {
+				usage_count(ROM_write_counts, real_address);
+			}
+		}
+		mark_dirty(ROM_dirty, real_address);
 		ROM[real_address] = value;
 
 		// fmt::print("Writing to hidden ram at addr: ${:04X}, bank ${:02X}\n", address, romBank);
@@ -359,7 +465,7 @@ static uint8_t sound_read(uint16_t address)
 // Memory Table Access
 //
 
-template <const uint8_t MAP[100], uint8_t BYTE>
+template <const uint8_t MAP[100], uint8_t BYTE, bool CHECKED>
 static void real_write(uint16_t address, uint8_t value);
 
 template <const uint8_t MAP[100], uint8_t BYTE>
@@ -387,24 +493,33 @@ static uint8_t debug_read(uint16_t address, uint8_t bank)
 	}
 }
 
-template <const uint8_t MAP[100], uint8_t BYTE>
+template <const uint8_t MAP[100], uint8_t BYTE, bool CHECKED>
 static uint8_t real_read(uint16_t address)
 {
 	if constexpr (&MAP[0] == &memory_map_hi[0]) {
 		switch (MAP[(address >> (BYTE * 8)) & 0xff]) {
 			case MEMMAP_NULL: return 0;
 			case MEMMAP_DIRECT: {
-				if ((RAM_written[address >> 6] & ((uint64_t)1 << (address & 0x3f))) == 0 && Memory_params.enable_uninitialized_access_warning) {
-					fmt::print("Warning: {:02X}:{:04X} accessed uninitialized RAM address {:02X}:{:04X}\n", bank6502(debug_state6502.pc), debug_state6502.pc, 0, address);
+				if constexpr (CHECKED) {
+					if ((RAM_written[address >> 6] & ((uint64_t)1 << (address & 0x3f))) == 0 && Memory_params.enable_uninitialized_access_warning) {
+						fmt::print("Warning: {:02X}:{:04X} accessed uninitialized RAM address {:02X}:{:04X}\n", bank6502(debug_state6502.pc), debug_state6502.pc, 0, address);
+					}
+					if (Memory_params.enable_memory_stats) {
+						usage_count(RAM_read_counts, address);
+					}
 				}
-				++RAM_read_counts[address];
 				return RAM[address];
 			}
-			case MEMMAP_RAMBANK: return real_ram_read(address); break;
-			case MEMMAP_ROMBANK: return real_rom_read(address); break;
+			case MEMMAP_RAMBANK: return real_ram_read<CHECKED>(address); break;
+			case MEMMAP_ROMBANK: return real_rom_read<CHECKED>(address); break;
 			case MEMMAP_IO:
-				++RAM_read_counts[address];
-				return real_read<memory_map_io, 0>(address);
+				if constexpr (CHECKED) {
+					if (Memory_params.enable_memory_stats) {
+						usage_count(RAM_read_counts, address);
+					}
+				}
+				machine_sync_io();
+				return real_read<memory_map_io, 0, CHECKED>(address);
 			default: return 0;
 		}
 	} else {
@@ -427,13 +542,14 @@ static void debug_write(uint16_t address, uint8_t bank, uint8_t value)
 		switch (MAP[(address >> (BYTE * 8)) & 0xff]) {
 			case MEMMAP_NULL: break;
 			case MEMMAP_DIRECT:
+				mark_dirty(RAM_dirty, address);
 				RAM[address] = value;
 				if (address == 1)
 					ROM_BANK = value;
 				break;
 			case MEMMAP_RAMBANK: debug_ram_write(address, bank, value); break;
 			case MEMMAP_ROMBANK: debug_rom_write(address, bank, value); break;
-			case MEMMAP_IO: real_write<memory_map_io, 0>(address, value); break;
+			case MEMMAP_IO: real_write<memory_map_io, 0, false>(address, value); break;
 			default: break;
 		}
 	} else {
@@ -449,24 +565,34 @@ static void debug_write(uint16_t address, uint8_t bank, uint8_t value)
 	}
 }
 
-template <const uint8_t MAP[100], uint8_t BYTE>
+template <const uint8_t MAP[100], uint8_t BYTE, bool CHECKED>
 static void real_write(uint16_t address, uint8_t value)
 {
 	if constexpr (&MAP[0] == &memory_map_hi[0]) {
 		switch (MAP[(address >> (BYTE * 8)) & 0xff]) {
 			case MEMMAP_NULL: break;
 			case MEMMAP_DIRECT:
-				RAM_written[address >> 6] |= (uint64_t)1 << (address & 0x3f);
-				++RAM_write_counts[address];
+				if constexpr (CHECKED) {
+					RAM_written[address >> 6] |= (uint64_t)1 << (address & 0x3f);
+					if (Memory_params.enable_memory_stats) {
+						usage_count(RAM_write_counts, address);
+					}
+				}
+				mark_dirty(RAM_dirty, address);
 				RAM[address] = value;
 				if (address == 1)
 					ROM_BANK = value;
 				break;
-			case MEMMAP_RAMBANK: real_ram_write(address, value); break;
-			case MEMMAP_ROMBANK: real_rom_write(address, value); break;
+			case MEMMAP_RAMBANK: real_ram_write<CHECKED>(address, value); break;
+			case MEMMAP_ROMBANK: real_rom_write<CHECKED>(address, value); break;
 			case MEMMAP_IO: 
-				++RAM_write_counts[address];
-				real_write<memory_map_io, 0>(address, value);
+				if constexpr (CHECKED) {
+					if (Memory_params.enable_memory_stats) {
+						usage_count(RAM_write_counts, address);
+					}
+				}
+				machine_sync_io();
+				real_write<memory_map_io, 0, CHECKED>(address, value);
 				break;
 			default: break;
 		}
@@ -497,11 +623,14 @@ uint8_t debug_read6502(uint16_t address, uint8_t bank)
 	return debug_read<memory_map_hi, 1>(address, bank);
 }
 
-uint8_t read6502(uint16_t address)
+template <bool CHECKED>
+static uint8_t read6502_impl(uint16_t address)
 {
-	debug6502 |= (DEBUG6502_READ | DEBUG6502_EXEC) & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	if constexpr (CHECKED) {
+		debug6502 |= (DEBUG6502_READ | DEBUG6502_EXEC) & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	}
 
-	uint8_t value = real_read<memory_map_hi, 1>(address);
+	uint8_t value = real_read<memory_map_hi, 1, CHECKED>(address);
 #if defined(TRACE)
 	if (Options.log_mem_read) {
 		fmt::print("{:04X} -> {:02X}\n", address, value);
@@ -510,21 +639,38 @@ uint8_t read6502(uint16_t address)
 	return value;
 }
 
+uint8_t read6502(uint16_t address)
+{
+	return Checked_access ? read6502_impl<true>(address) : read6502_impl<false>(address);
+}
+
 void debug_write6502(uint16_t address, uint8_t bank, uint8_t value)
 {
 	debug_write<memory_map_hi, 1>(address, bank, value);
 }
 
-void write6502(uint16_t address, uint8_t value)
+template <bool CHECKED>
+static void write6502_impl(uint16_t address, uint8_t value)
 {
-	debug6502 |= DEBUG6502_WRITE & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	if constexpr (CHECKED) {
+		debug6502 |= DEBUG6502_WRITE & debugger_get_flags(address, address >= 0xc000 ? memory_get_rom_bank() : memory_get_ram_bank());
+	}
 	if (~debug6502 & DEBUG6502_WRITE) {
 #if defined(TRACE)
 		if (Options.log_mem_write) {
 			fmt::print("{:02X} -> {:04X}\n", value, address);
 		}
 #endif
-		real_write<memory_map_hi, 1>(address, value);
+		real_write<memory_map_hi, 1, CHECKED>(address, value);
+	}
+}
+
+void write6502(uint16_t address, uint8_t value)
+{
+	if (Checked_access) {
+		write6502_impl<true>(address, value);
+	} else {
+		write6502_impl<false>(address, value);
 	}
 }
 
@@ -552,6 +698,20 @@ void memory_save(x16file *f, bool dump_ram, bool dump_bank)
 	}
 }
 
+void memory_save_restore(savestate &state)
+{
+	if (!state.memory_excluded()) {
+		state.save_restore(RAM, RAM_SIZE);
+		state.save_restore(ROM, ROM_SIZE);
+	}
+	state.save_restore(rom_bank_register);
+	if (!state.memory_excluded()) {
+		state.save_restore(RAM_written, RAM_WRITE_BLOCKS * sizeof(uint64_t));
+	}
+	state.save_restore(clock_snap);
+	state.save_restore(clock_base);
+}
+
 //
 // Banking access/mutates
 //
@@ -567,9 +727,43 @@ void memory_set_bank(uint16_t address, uint8_t bank)
 
 void memory_set_ram_bank(uint8_t bank)
 {
+	mark_dirty(RAM_dirty, 0);
 	RAM_BANK = bank & (NUM_MAX_RAM_BANKS - 1);
 }
 
+void memory_set_dirty_tracking(bool enable)
+{
+	Dirty_tracking = enable;
+}
+
+void memory_mark_dirty(uint32_t ram_offset, uint32_t size)
+{
+	const uint32_t ram_size = RAM_SIZE;
+	for (uint32_t offset = ram_offset & ~(MEMORY_DIRTY_BLOCK_SIZE - 1); offset < ram_offset + size && offset < ram_size; offset += MEMORY_DIRTY_BLOCK_SIZE) {
+		mark_dirty(RAM_dirty, offset);
+	}
+}
+
+static void take_dirty_blocks(uint64_t *dirty, uint32_t size, std::vector<uint32_t> &blocks)
+{
+	const uint32_t words = DIRTY_WORDS(size);
+	for (uint32_t w = 0; w < words; ++w) {
+		uint64_t bits = dirty[w];
+		while (bits != 0) {
+			const int bit = std::countr_zero(bits);
+			blocks.push_back(((w << 6) + bit) << DIRTY_BLOCK_SHIFT);
+			bits &= bits - 1;
+		}
+		dirty[w] = 0;
+	}
+}
+
+void memory_take_dirty_blocks(std::vector<uint32_t> &ram_blocks, std::vector<uint32_t> &rom_blocks)
+{
+	take_dirty_blocks(RAM_dirty, RAM_SIZE, ram_blocks);
+	take_dirty_blocks(ROM_dirty, ROM_SIZE, rom_blocks);
+}
+
 uint8_t memory_get_ram_bank()
 {
 	return RAM_BANK;
@@ -596,8 +790,61 @@ uint8_t memory_get_current_bank(uint16_t address)
 	}
 }
 
+//
+// One CSV row per 256-byte block with any activity, in physical memory order, so the
+// result can be fed straight into a plotting tool as a heatmap.
+//
+
+#define HEATMAP_BLOCK_SIZE (0x100)
+
+static void write_heatmap_rows(x16file *f, const char *region, const usage_counts &reads, const usage_counts &writes, uint32_t base, uint32_t size, int bank, uint16_t address)
+{
+	for (uint32_t offset = 0; offset < size; offset += HEATMAP_BLOCK_SIZE) {
+		const uint32_t page = (base + offset) >> USAGE_PAGE_SHIFT;
+		if (reads.pages[page] == nullptr && writes.pages[page] == nullptr) {
+			offset += USAGE_PAGE_SIZE - HEATMAP_BLOCK_SIZE - ((base + offset) & (USAGE_PAGE_SIZE - 1));
+			continue;
+		}
+		uint64_t read_total  = 0;
+		uint64_t write_total = 0;
+		for (uint32_t i = 0; i < HEATMAP_BLOCK_SIZE; ++i) {
+			read_total += usage_get(reads, base + offset + i);
+			write_total += usage_get(writes, base + offset + i);
+		}
+		if (read_total > 0 || write_total > 0) {
+			x16write(f, fmt::format("{},{:02x},{:04x},{},{}\n", region, bank, address + offset, read_total, write_total));
+		}
+	}
+}
+
+static void memory_dump_usage_heatmap()
+{
+	std::filesystem::path heatmap_path = Options.dump_memstats_path;
+	heatmap_path.replace_extension(".heatmap.csv");
+
+	const std::string dump_path = heatmap_path.generic_string();
+	x16file *dumpfile = x16open(dump_path.c_str(), "w");
+	if (dumpfile == nullptr) {
+		fmt::print("Warning: Could not dump memory heatmap to {}.\n", dump_path);
+		return;
+	}
+	x16write(dumpfile, "region,bank,address,reads,writes\n");
+	write_heatmap_rows(dumpfile, "ram", RAM_read_counts, RAM_write_counts, 0, 0xa000, 0, 0);
+	for (int bank = 0; bank < Options.num_ram_banks; ++bank) {
+		write_heatmap_rows(dumpfile, "bank", RAM_read_counts, RAM_write_counts, 0xa000 + (bank << 13), 0x2000, bank, 0xa000);
+	}
+	for (int bank = 0; bank < TOTAL_ROM_BANKS; ++bank) {
+		write_heatmap_rows(dumpfile, "rom", ROM_read_counts, ROM_write_counts, bank << 14, 0x4000, bank, 0xc000);
+	}
+	x16close(dumpfile);
+}
+
 void memory_dump_usage_counts()
 {
+	if (!Memory_params.enable_memory_stats) {
+		return;
+	}
+
 	const std::string dump_path = Options.dump_memstats_path.generic_string();
 	x16file *dumpfile = x16open(dump_path.c_str(), "w");
 	if (dumpfile == nullptr) {
@@ -609,14 +856,14 @@ void memory_dump_usage_counts()
 	x16write(dumpfile, "system RAM reads:\n");
 	int addr;
 	for (addr = 0; addr < 0xa000; ++addr) {
-		if (RAM_read_counts[addr] > 0) {
-			x16write(dumpfile, fmt::format("r {0:04x} {1}\n", addr, RAM_read_counts[addr]));
+		if (usage_get(RAM_read_counts, addr) > 0) {
+			x16write(dumpfile, fmt::format("r {0:04x} {1}\n", addr, usage_get(RAM_read_counts, addr)));
 		}
 	}
 	x16write(dumpfile, "\nsystem RAM writes:\n");
 	for (addr = 0; addr < 0xa000; ++addr) {
-		if (RAM_write_counts[addr] > 0) {
-			x16write(dumpfile, fmt::format("w {0:04x} {1}\n", addr, RAM_write_counts[addr]));
+		if (usage_get(RAM_write_counts, addr) > 0) {
+			x16write(dumpfile, fmt::format("w {0:04x} {1}\n", addr, usage_get(RAM_write_counts, addr)));
 		}
 	}
 	x16write(dumpfile, "\nbanked RAM reads:\n");
@@ -625,8 +872,8 @@ void memory_dump_usage_counts()
 		for (addr = 0xa000; addr < 0xc000; ++addr) {
 			const int ramBank      = bank % Options.num_ram_banks;
 			const int real_address = (ramBank << 13) + addr;
-			if (RAM_read_counts[real_address] > 0) {
-				x16write(dumpfile, fmt::format("r {0:02x}:{1:04x} {2}\n", bank, addr, RAM_read_counts[real_address]));
+			if (usage_get(RAM_read_counts, real_address) > 0) {
+				x16write(dumpfile, fmt::format("r {0:02x}:{1:04x} {2}\n", bank, addr, usage_get(RAM_read_counts, real_address)));
 			}
 		}
 	}
@@ -635,8 +882,8 @@ void memory_dump_usage_counts()
 		for (addr = 0xa000; addr < 0xc000; ++addr) {
 			const int ramBank      = bank % Options.num_ram_banks;
 			const int real_address = (ramBank << 13) + addr;
-			if (RAM_write_counts[real_address] > 0) {
-				x16write(dumpfile, fmt::format("w {0:02x}:{1:04x} {2}\n", bank, addr, RAM_write_counts[real_address]));
+			if (usage_get(RAM_write_counts, real_address) > 0) {
+				x16write(dumpfile, fmt::format("w {0:02x}:{1:04x} {2}\n", bank, addr, usage_get(RAM_write_counts, real_address)));
 			}
 		}
 	}
@@ -645,8 +892,8 @@ void memory_dump_usage_counts()
 		for (addr = 0xc000; addr < 0x10000; ++addr) {
 			const int romBank      = bank % TOTAL_ROM_BANKS;
 			const int real_address = (romBank << 14) + addr - 0xc000;
-			if (ROM_read_counts[real_address] > 0) {
-				x16write(dumpfile, fmt::format("r {0:02x}:{1:04x} {2}\n", bank, addr, ROM_read_counts[real_address]));
+			if (usage_get(ROM_read_counts, real_address) > 0) {
+				x16write(dumpfile, fmt::format("r {0:02x}:{1:04x} {2}\n", bank, addr, usage_get(ROM_read_counts, real_address)));
 			}
 		}
 	}
@@ -655,10 +902,11 @@ void memory_dump_usage_counts()
 		for (addr = 0xc000; addr < 0x10000; ++addr) {
 			const int romBank      = bank % TOTAL_ROM_BANKS;
 			const int real_address = (romBank << 14) + addr - 0xc000;
-			if (ROM_write_counts[real_address] > 0) {
-				x16write(dumpfile, fmt::format("w {0:02x}:{1:04x} {2}\n", bank, addr, ROM_write_counts[real_address]));
+			if (usage_get(ROM_write_counts, real_address) > 0) {
+				x16write(dumpfile, fmt::format("w {0:02x}:{1:04x} {2}\n", bank, addr, usage_get(ROM_write_counts, real_address)));
 			}
 		}
 	}
 	x16close(dumpfile);
-}
\ No newline at end of file
+	memory_dump_usage_heatmap();
+}
@@ -10,18 +10,25 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <vector>
 #include "files.h"
 
+class savestate;
+
 #define NUM_MAX_RAM_BANKS 256
+#define MEMORY_DIRTY_BLOCK_SIZE 64
 
 struct memory_init_params {
 	uint16_t num_banks;
 	bool     randomize;
 	bool     enable_uninitialized_access_warning;
+	bool     enable_memory_stats;
+	uint32_t random_seed; // also seeds the initial VRAM contents
 };
 
 void memory_init(const memory_init_params &params);
 void memory_reset();
+void memory_set_breakpoints_armed(bool armed);
 
 uint8_t debug_read6502(uint16_t address);
 uint8_t debug_read6502(uint16_t address, uint8_t bank);
@@ -30,6 +37,7 @@ void    debug_write6502(uint16_t address, uint8_t bank, uint8_t value);
 void    write6502(uint16_t address, uint8_t value);
 uint8_t bank6502(uint16_t address);
 void    memory_save(x16file *f, bool dump_ram, bool dump_bank);
+void    memory_save_restore(savestate &state);
 void    vp6502(void);
 
 void memory_set_bank(uint16_t address, uint8_t bank);
@@ -43,4 +51,13 @@ uint8_t memory_get_current_bank(uint16_t address);
 
 void memory_dump_usage_counts();
 
+// Dirty blocks are only recorded while tracking is enabled.
+void memory_set_dirty_tracking(bool enable);
+
+// Flag RAM changed by the host (file loads, injected keys, etc.) for memory_take_dirty_blocks().
+void memory_mark_dirty(uint32_t ram_offset, uint32_t size);
+
+// Append the offsets of RAM and ROM blocks written since the last call, then clear them.
+void memory_take_dirty_blocks(std::vector<uint32_t> &ram_blocks, std::vector<uint32_t> &rom_blocks);
+
 #endif
@@ -62,6 +62,17 @@ static void usage()
 	fmt::print("\tInject a BASIC program in ASCII encoding through the\n");
 	fmt::print("\tkeyboard.\n");
 
+	fmt::print("-benchmark [<workload>,...]\n");
+	fmt::print("\tRun the named benchmark workloads headless (default: all), then\n");
+	fmt::print("\tprint their results as JSON and exit. Workloads: kernal_boot,\n");
+	fmt::print("\tbasic_loop, vera_fill, fx_lines, tile_scroll, ym_music, sd_streaming.\n");
+
+	fmt::print("-benchmark_frames <frames>\n");
+	fmt::print("\tNumber of frames to measure per benchmark workload. Default: 600\n");
+
+	fmt::print("-benchmark_out <file>\n");
+	fmt::print("\tWrite benchmark results to a file instead of the console.\n");
+
 	fmt::print("-debug <address>\n");
 	fmt::print("\tSet a breakpoint in the debugger\n");
 
@@ -78,6 +89,10 @@ static void usage()
 	fmt::print("\tWith the BASIC statement \"LIST\", this can be used\n");
 	fmt::print("\tto detokenize a BASIC program.\n");
 
+	fmt::print("-frameskip [<frames>]\n");
+	fmt::print("\tSkip drawing frames while the host can't keep up with real time,\n");
+	fmt::print("\tbut never more than this many in a row. The default is 4.\n");
+
 	fmt::print("-fullscreen\n");
 	fmt::print("\tStart up in fullscreen mode instead of in a window.\n");
 
@@ -88,6 +103,18 @@ static void usage()
 	fmt::print("\tRecord a gif for the video output.\n");
 	fmt::print("\tUse ,wait to start paused.\n");
 
+	fmt::print("-deferupload\n");
+	fmt::print("\tUpload each frame one frame late, so the driver can finish copying it\n");
+	fmt::print("\twhile the next one is written. Adds a frame of lag; meant for software GL.\n");
+
+	fmt::print("-gpupalette\n");
+	fmt::print("\tUpload 8-bit color indices and look the palette up in a shader,\n");
+	fmt::print("\tinstead of uploading a 32-bit frame.\n");
+
+	fmt::print("-headless\n");
+	fmt::print("\tRun without a window, audio or input handling, as fast as possible.\n");
+	fmt::print("\tVideo is still rendered for -gif recording. Implies -nosound.\n");
+
 	fmt::print("-help\n");
 	fmt::print("\tPrint this message and exit.\n");
 
@@ -102,6 +129,10 @@ static void usage()
 	fmt::print("-keymap <keymap>\n");
 	fmt::print("\tEnable a specific keyboard layout decode table.\n");
 
+	fmt::print("-loadstate <file>\n");
+	fmt::print("\tRestore a machine save state after reset, instead of booting from scratch.\n");
+	fmt::print("\tThe state must have been saved with the same ROM and RAM size.\n");
+
 #if defined(TRACE)
 	fmt::print("-log {{K|S|V|Cl|Cb|Ca|Co|Mw|Mr}}...\n");
 	fmt::print("\tEnable logging of (K)eyboard, (S)peed, (V)ideo, (C)pu, (M)emory.\n");
@@ -121,8 +152,9 @@ static void usage()
 	fmt::print("\tMultiple characters are possible, e.g. -log KS\n");
 #endif
 
-	fmt::print("-memorystats\n");
-	fmt::print("\tGenerate a memory_stats.txt file when the emulator exits.\n");
+	fmt::print("-memorystats <file>\n");
+	fmt::print("\tCount reads and writes of every memory location and write them to <file> when the emulator exits.\n");
+	fmt::print("\tA per-256-byte heatmap is also written next to it, with the extension replaced by .heatmap.csv.\n");
 
 	fmt::print("-nobinds\n");
 	fmt::print("\tDisable most emulator keyboard shortcuts.\n");
@@ -154,6 +186,10 @@ static void usage()
 	fmt::print("\t(.PRG file with 2 byte start address header)\n");
 	fmt::print("\tThe override load address is hex without a prefix.\n");
 
+	fmt::print("-profile_trace <file>\n");
+	fmt::print("\tRecord per-subsystem timings to a file in Chrome's trace event\n");
+	fmt::print("\tformat, for chrome://tracing or Perfetto.\n");
+
 	fmt::print("-quality {{nearest|linear|best}}\n");
 	fmt::print("\tScaling algorithm quality\n");
 
@@ -161,6 +197,23 @@ static void usage()
 	fmt::print("\tSpecify banked RAM size in KB (8, 16, 32, ..., 2048).\n");
 	fmt::print("\tThe default is 512.\n");
 
+	fmt::print("-record <file>\n");
+	fmt::print("\tRecord keyboard, mouse and joystick input, resets and NMIs to a file,\n");
+	fmt::print("\tstamped with the CPU clock, for playback with -replay.\n");
+
+	fmt::print("-renderthread\n");
+	fmt::print("\tRender video on a separate thread, so the CPU can run ahead of the beam.\n");
+	fmt::print("\tMost useful in warp mode on machines with more than one core.\n");
+
+	fmt::print("-replay <file>\n");
+	fmt::print("\tPlay back a file written by -record, ignoring live input. Use the same\n");
+	fmt::print("\toptions, ROM and disk contents as the recording for identical results.\n");
+
+	fmt::print("-rewind <seconds>\n");
+	fmt::print("\tKeep this many seconds of frame history, so the machine can be\n");
+	fmt::print("\tstepped backwards from the monitor or the Machine menu.\n");
+	fmt::print("\tThe default is 0, which disables rewind.\n");
+
 	fmt::print("-rom <rom.bin>\n");
 	fmt::print("\tOverride KERNAL/BASIC/* ROM file.\n");
 
@@ -394,6 +447,39 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-benchmark")) {
+			argc--;
+			argv++;
+			if (argc && argv[0][0] != '-') {
+				ini["benchmark"] = argv[0];
+				argc--;
+				argv++;
+			} else {
+				ini["benchmark"] = "all";
+			}
+
+		} else if (!strcmp(argv[0], "-benchmark_frames")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["benchmark_frames"] = argv[0];
+			argc--;
+			argv++;
+
+		} else if (!strcmp(argv[0], "-benchmark_out")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["benchmark_out"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-create_patch")) {
 			argc--;
 			argv++;
@@ -444,6 +530,18 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 				ini["echo"] = "cooked";
 			}
 
+		} else if (!strcmp(argv[0], "-frameskip")) {
+			argc--;
+			argv++;
+
+			if (argc && isdigit(argv[0][0])) {
+				ini["frameskip"] = argv[0];
+				argc--;
+				argv++;
+			} else {
+				ini["frameskip"] = "true";
+			}
+
 		} else if (!strcmp(argv[0], "-hypercall_path")) {
 			argc--;
 			argv++;
@@ -466,6 +564,21 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argv++;
 			argc--;
 
+		} else if (!strcmp(argv[0], "-deferupload")) {
+			argc--;
+			argv++;
+			ini["deferupload"] = "true";
+
+		} else if (!strcmp(argv[0], "-gpupalette")) {
+			argc--;
+			argv++;
+			ini["gpupalette"] = "true";
+
+		} else if (!strcmp(argv[0], "-headless")) {
+			argc--;
+			argv++;
+			ini["headless"] = "true";
+
 		} else if (!strcmp(argv[0], "-help")) {
 			argc--;
 			argv++;
@@ -506,6 +619,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-loadstate")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["loadstate"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-log")) {
 			argc--;
 			argv++;
@@ -607,6 +731,17 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argc--;
 			argv++;
 
+		} else if (!strcmp(argv[0], "-profile_trace")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["profile_trace"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-quality")) {
 			argc--;
 			argv++;
@@ -638,6 +773,44 @@ static void parse_cmdline(mINI::INIMap<std::string> &ini, int argc, char **argv)
 			argv++;
 			ini["zeroram"] = "true";
 
+		} else if (!strcmp(argv[0], "-record")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["record"] = argv[0];
+			argc--;
+			argv++;
+
+		} else if (!strcmp(argv[0], "-renderthread")) {
+			argc--;
+			argv++;
+			ini["renderthread"] = "true";
+
+		} else if (!strcmp(argv[0], "-replay")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["replay"] = argv[0];
+			argc--;
+			argv++;
+
+		} else if (!strcmp(argv[0], "-rewind")) {
+			argc--;
+			argv++;
+			if (!argc || argv[0][0] == '-') {
+				usage();
+			}
+
+			ini["rewind"] = argv[0];
+			argc--;
+			argv++;
+
 		} else if (!strcmp(argv[0], "-rom")) {
 			argc--;
 			argv++;
@@ -912,6 +1085,10 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.prg_override_start          = (uint16_t)strtol(prg_override_address, nullptr, 16);
 	}
 
+	if (ini.has("profile_trace")) {
+		opts.profile_trace_path = ini["profile_trace"];
+	}
+
 	if (ini.has("run") && ini["run"] == "true") {
 		opts.run_after_load = true;
 	}
@@ -929,6 +1106,21 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.nvram_path = ini["nvram"];
 	}
 
+	if (ini.has("loadstate")) {
+		opts.loadstate_path = ini["loadstate"];
+	}
+
+	if (ini.has("record")) {
+		opts.record_path = ini["record"];
+	}
+
+	if (ini.has("replay")) {
+		if (ini.has("record")) {
+			return "replay";
+		}
+		opts.replay_path = ini["replay"];
+	}
+
 	if (ini.has("sdcard")) {
 		opts.sdcard_path = ini["sdcard"];
 	}
@@ -941,6 +1133,14 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		}
 	}
 
+	if (ini.has("frameskip")) {
+		if (ini["frameskip"] == "true") {
+			opts.frameskip = 4;
+		} else {
+			opts.frameskip = atoi(ini["frameskip"].c_str());
+		}
+	}
+
 	if (ini.has("echo")) {
 		char const *echo_mode = ini["echo"].c_str();
 		if (!strcmp(echo_mode, "raw")) {
@@ -1129,10 +1329,45 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.audio_dev_name = ini["sound"];
 	}
 
+	if (ini.has("headless") && ini["headless"] == "true") {
+		if (ini.has("sound")) {
+			return "headless";
+		}
+		opts.headless = true;
+		opts.no_sound = true;
+	}
+
+	if (ini.has("benchmark")) {
+		if (ini.has("sound")) {
+			return "benchmark";
+		}
+		opts.benchmark = ini["benchmark"];
+		opts.headless  = true;
+		opts.no_sound  = true;
+	}
+
+	if (ini.has("benchmark_frames")) {
+		opts.benchmark_frames = (int)strtol(ini["benchmark_frames"].c_str(), NULL, 10);
+		if (opts.benchmark_frames <= 0) {
+			return "benchmark_frames";
+		}
+	}
+
+	if (ini.has("benchmark_out")) {
+		opts.benchmark_out_path = ini["benchmark_out"];
+	}
+
 	if (ini.has("abufs")) {
 		opts.audio_buffers = (int)strtol(ini["abufs"].c_str(), NULL, 10);
 	}
 
+	if (ini.has("rewind")) {
+		opts.rewind_seconds = (int)strtol(ini["rewind"].c_str(), NULL, 10);
+		if (opts.rewind_seconds < 0) {
+			return "rewind";
+		}
+	}
+
 	if (ini.has("rtc") && ini["rtc"] == "true") {
 		opts.set_system_time = true;
 	}
@@ -1149,6 +1384,18 @@ static char const *set_options(options &opts, mINI::INIMap<std::string> &ini)
 		opts.no_hypercalls = true;
 	}
 
+	if (ini.has("gpupalette") && ini["gpupalette"] == "true") {
+		opts.gpu_palette = true;
+	}
+
+	if (ini.has("deferupload") && ini["deferupload"] == "true") {
+		opts.defer_upload = true;
+	}
+
+	if (ini.has("renderthread") && ini["renderthread"] == "true") {
+		opts.render_thread = true;
+	}
+
 	if (ini.has("ymirq") && ini["ymirq"] == "true") {
 		opts.ym_irq = true;
 	}
@@ -1194,6 +1441,7 @@ static void set_panels(mINI::INIMap<std::string> &ini)
 	get_option("symbols_list", Show_symbols_list);
 	get_option("symbols_files", Show_symbols_files);
 	get_option("cpu_visualizer", Show_cpu_visualizer);
+	get_option("profiler", Show_profiler);
 	get_option("vram_visualizer", Show_VRAM_visualizer);
 	get_option("vera_monitor", Show_VERA_monitor);
 	get_option("vera_palette", Show_VERA_palette);
@@ -1359,6 +1607,7 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	// set_option("patch", Options.patch_path, Default_options.patch_path);
 	// set_option("ignore_patch", !Options.apply_patch, Options.patch_path.empty());
 	set_option("ram", Options.num_ram_banks * 8, Default_options.num_ram_banks * 8);
+	set_option("rewind", Options.rewind_seconds, Default_options.rewind_seconds);
 	set_option("keymap", keymaps_strict[Options.keymap], keymaps_strict[Default_options.keymap]);
 	set_option("hypercall_path", Options.fsroot_path, Default_options.fsroot_path);
 	set_comma_option("prg", Options.prg_path, Default_options.prg_path, Options.prg_override_start, Default_options.prg_override_start);
@@ -1368,6 +1617,7 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	set_option("nvram", Options.nvram_path, Default_options.nvram_path);
 	set_option("sdcard", Options.sdcard_path, Default_options.sdcard_path);
 	set_option("warp", Options.warp_factor > 0, Default_options.warp_factor > 0);
+	set_option("frameskip", Options.frameskip, Default_options.frameskip);
 	set_option("echo", echo_mode_str(Options.echo_mode), echo_mode_str(Default_options.echo_mode));
 
 	if (all || Options.log_keyboard != Default_options.log_keyboard || Options.log_speed != Default_options.log_speed || Options.log_video != Default_options.log_video) {
@@ -1410,6 +1660,8 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	set_option("scale", Options.window_scale, Default_options.window_scale);
 	set_option("quality", quality_str(Options.scale_quality), quality_str(Default_options.scale_quality));
 	set_option("vsync", vsync_mode_str(Options.vsync_mode), vsync_mode_str(Default_options.vsync_mode));
+	set_option("gpupalette", Options.gpu_palette, Default_options.gpu_palette);
+	set_option("deferupload", Options.defer_upload, Default_options.defer_upload);
 	set_option("nosound", Options.no_sound, Default_options.no_sound);
 	set_option("sound", Options.audio_dev_name, Default_options.audio_dev_name);
 	set_option("abufs", Options.audio_buffers, Default_options.audio_buffers);
@@ -1418,6 +1670,7 @@ static void set_ini_main(mINI::INIMap<std::string> &ini_main, bool all)
 	set_option("nohostieee", Options.no_ieee_hypercalls, Default_options.no_ieee_hypercalls);
 	set_option("nohypercalls", Options.no_hypercalls, Default_options.no_hypercalls);
 	set_option("serial", Options.enable_serial, Default_options.enable_serial);
+	set_option("renderthread", Options.render_thread, Default_options.render_thread);
 	set_option("ymirq", Options.ym_irq, Default_options.ym_irq);
 	set_option("ymstrict", Options.ym_strict, Default_options.ym_strict);
 	set_option("widescreen", Options.widescreen, Default_options.widescreen);
@@ -1476,6 +1729,7 @@ void set_ini_panels(mINI::INIMap<std::string> &ini, bool all)
 	set_option("symbols_list", Show_symbols_list, false);
 	set_option("symbols_files", Show_symbols_files, false);
 	set_option("cpu_visualizer", Show_cpu_visualizer, false);
+	set_option("profiler", Show_profiler, false);
 	set_option("vram_visualizer", Show_VRAM_visualizer, false);
 	set_option("vera_monitor", Show_VERA_monitor, false);
 	set_option("vera_palette", Show_VERA_palette, false);
@@ -1488,8 +1742,13 @@ void set_ini_panels(mINI::INIMap<std::string> &ini, bool all)
 
 void set_ini_window(mINI::INIMap<std::string> &ini)
 {
+	SDL_Window *window = display_get_window();
+	if (window == nullptr) {
+		return;
+	}
+
 	int width, height;
-	SDL_GetWindowSize(display_get_window(), &width, &height);
+	SDL_GetWindowSize(window, &width, &height);
 	ini["width"] = std::to_string(width);
 	ini["height"] = std::to_string(height);
 }
@@ -1617,6 +1876,10 @@ void save_options(bool all)
 
 void save_options_on_close(bool all)
 {
+	if (Options.headless) {
+		return;
+	}
+
 	options_log_verbose("Saving ini (on close) to: {}\n", std::filesystem::absolute(Options_ini_path).generic_string());
 
 	mINI::INIFile file(Options_ini_path.generic_string());
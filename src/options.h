@@ -47,6 +47,11 @@ struct options {
 	std::filesystem::path                                 rom_path = "rom.bin";
 	std::list<std::tuple<std::filesystem::path, uint8_t>> rom_carts;
 	std::filesystem::path                                 nvram_path  = "";
+	std::filesystem::path                                 loadstate_path = "";
+	std::filesystem::path                                 record_path    = "";
+	std::filesystem::path                                 replay_path    = "";
+	std::filesystem::path                                 benchmark_out_path = "";
+	std::filesystem::path                                 profile_trace_path = "";
 	std::filesystem::path                                 fsroot_path  = ".";
 	std::filesystem::path                                 startin_path = ".";
 	std::filesystem::path                                 prg_path    = "";
@@ -87,16 +92,26 @@ struct options {
 	uint8_t         keymap        = 0;  // KERNAL's default
 	int             test_number   = -1;
 	int             warp_factor   = 0;
+	int             frameskip     = 0;
 	int             window_scale  = 2;
 	bool            widescreen    = false;
 	bool            fullscreen    = false;
 	scale_quality_t scale_quality = scale_quality_t::NEAREST;
+	bool            gpu_palette   = false;
+	bool            defer_upload  = false;
 	vsync_mode_t    vsync_mode    = vsync_mode_t::VSYNC_MODE_GET_SYNC;
 
 	std::string audio_dev_name = "";
 	bool        no_sound       = false;
 	int         audio_buffers  = 8;
 
+	int rewind_seconds = 0;
+
+	bool headless = false;
+
+	std::string benchmark        = "";
+	int         benchmark_frames = 600;
+
 	bool set_system_time    = false;
 	bool no_keybinds        = false;
 	bool no_ieee_hypercalls = false;
@@ -104,6 +119,7 @@ struct options {
 	bool enable_serial      = false;
 	bool ym_irq             = false;
 	bool ym_strict          = false;
+	bool render_thread      = false;
 	bool memory_randomize   = true;
 	bool memory_uninit_warn = false;
 
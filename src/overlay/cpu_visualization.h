@@ -16,6 +16,7 @@ enum cpu_visualization_coloring {
 };
 
 void            cpu_visualization_enable(bool enable);
+bool            cpu_visualization_is_enabled();
 
 void            cpu_visualization_step();
 const uint32_t *cpu_visualization_get_framebuffer();
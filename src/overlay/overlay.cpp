@@ -27,11 +27,14 @@
 #include "disasm.h"
 #include "display.h"
 #include "glue.h"
+#include "input_replay.h"
 #include "joystick.h"
 #include "keyboard.h"
 #include "midi_overlay.h"
 #include "options_menu.h"
+#include "profiler.h"
 #include "psg_overlay.h"
+#include "rewind.h"
 #include "smc.h"
 #include "symbols.h"
 #include "timing.h"
@@ -53,6 +56,7 @@ bool Show_watch_list       = false;
 bool Show_symbols_list     = false;
 bool Show_symbols_files    = false;
 bool Show_cpu_visualizer   = false;
+bool Show_profiler         = false;
 bool Show_VRAM_visualizer  = false;
 bool Show_VERA_monitor     = false;
 bool Show_VERA_palette     = false;
@@ -383,7 +387,10 @@ static void draw_debugger_cpu_status()
 			ImGui::EndGroup();
 
 			ImGui::NewLine();
-			ImGui::InputHexLabel("RAM Bank", RAM[0]);
+			uint8_t ram_bank = memory_get_ram_bank();
+			if (ImGui::InputHexLabel("RAM Bank", ram_bank)) {
+				memory_set_ram_bank(ram_bank);
+			}
 			uint8_t rom_bank = memory_get_rom_bank();
 			if (ImGui::InputHexLabel("ROM Bank", rom_bank)) {
 				memory_set_rom_bank(rom_bank);
@@ -752,6 +759,80 @@ static void draw_debugger_cpu_visualizer()
 	ImGui::Image((void *)(intptr_t)vis.get_texture_id(), ImGui::GetContentRegionAvail(), vis.get_top_left(0), vis.get_bottom_right(0));
 }
 
+static void draw_debugger_profiler()
+{
+	const uint32_t num_frames = profiler_frame_count();
+	if (num_frames == 0) {
+		ImGui::TextDisabled("Waiting for a frame...");
+		return;
+	}
+
+	profiler_frame last;
+	profiler_get_frame(0, last);
+
+	// Oldest first, for the plots.
+	float    frame_ms[PROFILER_HISTORY_FRAMES];
+	float    cpu_ms[PROFILER_HISTORY_FRAMES];
+	uint64_t sum_cpu                                     = 0;
+	uint64_t sum_total                                   = 0;
+	uint64_t sum_sections[(int)profiler_section::count] = {};
+	for (uint32_t i = 0; i < num_frames; ++i) {
+		profiler_frame frame;
+		profiler_get_frame(num_frames - 1 - i, frame);
+		const uint64_t cpu = profiler_frame_cpu(frame);
+		frame_ms[i]        = (float)profiler_to_ms(frame.total);
+		cpu_ms[i]          = (float)profiler_to_ms(cpu);
+		sum_cpu += cpu;
+		sum_total += frame.total;
+		for (int s = 0; s < (int)profiler_section::count; ++s) {
+			sum_sections[s] += frame.sections[s];
+		}
+	}
+
+	ImGui::PlotLines("Frame (ms)", frame_ms, (int)num_frames, 0, nullptr, 0.0f, 33.3f, ImVec2(0, 60.0f));
+	ImGui::PlotLines("CPU (ms)", cpu_ms, (int)num_frames, 0, nullptr, 0.0f, 33.3f, ImVec2(0, 60.0f));
+
+	if (ImGui::BeginTable("profiler sections", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableSetupColumn("Last (ms)", ImGuiTableColumnFlags_WidthFixed, 72);
+		ImGui::TableSetupColumn("Avg (ms)", ImGuiTableColumnFlags_WidthFixed, 72);
+		ImGui::TableSetupColumn("Avg %", ImGuiTableColumnFlags_WidthFixed, 56);
+		ImGui::TableHeadersRow();
+
+		auto row = [&](const char *name, bool nested, uint64_t last_perf, uint64_t sum_perf) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (nested) {
+				ImGui::Indent();
+			}
+			ImGui::TextUnformatted(name);
+			if (nested) {
+				ImGui::Unindent();
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", profiler_to_ms(last_perf));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", profiler_to_ms(sum_perf) / num_frames);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", sum_total > 0 ? 100.0 * (double)sum_perf / (double)sum_total : 0.0);
+		};
+
+		row("frame", false, last.total, sum_total);
+		row("cpu", false, profiler_frame_cpu(last), sum_cpu);
+		for (int s = 0; s < (int)profiler_section::count; ++s) {
+			const profiler_section section = (profiler_section)s;
+			row(profiler_section_name(section), !profiler_section_is_top_level(section), last.sections[s], sum_sections[s]);
+		}
+		ImGui::EndTable();
+	}
+
+	uint64_t lines_reused;
+	uint64_t lines_rendered;
+	vera_video_get_line_cache_stats(&lines_reused, &lines_rendered);
+	const uint64_t lines_total = lines_reused + lines_rendered;
+	ImGui::Text("Scanlines reused: %llu of %llu (%.1f%%)", (unsigned long long)lines_reused, (unsigned long long)lines_total, lines_total > 0 ? 100.0 * (double)lines_reused / (double)lines_total : 0.0);
+}
+
 static void draw_debugger_vera_status()
 {
 	ImGui::BeginGroup();
@@ -2821,7 +2902,7 @@ static void draw_menu_bar()
 			if (ImGui::MenuItem("Open TXT file")) {
 				char *open_path = nullptr;
 				if (NFD_OpenDialog("txt", nullptr, &open_path) == NFD_OKAY && open_path != nullptr) {
-					keyboard_add_file(open_path);
+					input_replay_file(open_path);
 				}
 			}
 
@@ -2839,11 +2920,19 @@ static void draw_menu_bar()
 
 		if (ImGui::BeginMenu("Machine")) {
 			if (ImGui::MenuItem("Reset", Options.no_keybinds ? nullptr : "Ctrl-R")) {
-				machine_reset();
+				input_replay_reset();
 			}
 			if (ImGui::MenuItem("NMI")) {
-				nmi6502();
-				debugger_interrupt();
+				input_replay_nmi();
+			}
+			if (rewind_is_enabled()) {
+				const uint32_t available = rewind_available_frames();
+				if (ImGui::MenuItem("Rewind 1 Frame", nullptr, false, available >= 1)) {
+					rewind_step_back(1);
+				}
+				if (ImGui::MenuItem("Rewind 1 Second", nullptr, false, available >= 1)) {
+					rewind_step_back(std::min<uint32_t>(60, available));
+				}
 			}
 			if (ImGui::MenuItem("Save Dump", Options.no_keybinds ? nullptr : "Ctrl-S")) {
 				machine_dump("user menu request");
@@ -2954,6 +3043,9 @@ static void draw_menu_bar()
 				if (ImGui::Checkbox("CPU Visualizer", &Show_cpu_visualizer)) {
 					cpu_visualization_enable(Show_cpu_visualizer);
 				}
+				if (ImGui::Checkbox("Profiler", &Show_profiler)) {
+					profiler_set_user(profiler_user::overlay, Show_profiler);
+				}
 				ImGui::Checkbox("Breakpoints (Ctrl-Alt-B)", &Show_breakpoints);
 				ImGui::Checkbox("Watch List (Ctrl-Alt-W)", &Show_watch_list);
 				ImGui::Checkbox("Symbols List (Ctrl-Alt-S)", &Show_symbols_list);
@@ -3023,6 +3115,9 @@ static void draw_menu_bar()
 				} else {
 					ImGui::Text("Speed: %d%%", Timing_perf);
 				}
+				if (Options.frameskip > 0 && ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("%u frames skipped", Timing_skipped_frames);
+				}
 				break;
 			case timing_type::gpu_fps:
 				ImGui::Text("FPS: %2.2f", display_get_fps());
@@ -3170,6 +3265,15 @@ void overlay_draw()
 		ImGui::End();
 	}
 
+	if (Show_profiler) {
+		ImGui::SetNextWindowSize(ImVec2(400, 380), ImGuiCond_Once);
+		if (ImGui::Begin("Profiler", &Show_profiler)) {
+			draw_debugger_profiler();
+		}
+		ImGui::End();
+	}
+	profiler_set_user(profiler_user::overlay, Show_profiler);
+
 	if (Show_VRAM_visualizer) {
 		if (ImGui::Begin("Tile Visualizer", &Show_VRAM_visualizer)) {
 			draw_debugger_vram_visualizer();
@@ -14,6 +14,7 @@ extern bool Show_watch_list;
 extern bool Show_symbols_list;
 extern bool Show_symbols_files;
 extern bool Show_cpu_visualizer;
+extern bool Show_profiler;
 extern bool Show_VRAM_visualizer;
 extern bool Show_VERA_monitor;
 extern bool Show_VERA_palette;
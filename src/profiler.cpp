@@ -0,0 +1,202 @@
+#include "profiler.h"
+
+#include <SDL.h>
+#include <algorithm>
+#include <fmt/format.h>
+#include <string.h>
+#include <string>
+
+#include "files.h"
+#include "options.h"
+#include "ring_buffer.h"
+
+// Write trace events to disk once this much has been buffered.
+#define PROFILER_TRACE_FLUSH_SIZE (64 * 1024)
+
+bool Profiler_enabled = false;
+
+static uint32_t Users = 0;
+
+static uint64_t       Frame_start = 0;
+static profiler_frame Current_frame;
+static profiler_frame Totals;
+
+static ring_buffer<profiler_frame, PROFILER_HISTORY_FRAMES> History;
+
+static x16file    *Trace_file  = nullptr;
+static std::string Trace_buffer;
+static uint64_t    Trace_base  = 0;
+static bool        Trace_first = true;
+
+static double Perf_to_us = 0.0;
+
+static const char *Section_names[] = {
+	"video",
+	"render_line",
+	"audio",
+	"ym",
+	"devices",
+	"display",
+	"host",
+	"idle",
+};
+
+static_assert(sizeof(Section_names) / sizeof(Section_names[0]) == (size_t)profiler_section::count);
+
+//
+// Trace export, in Chrome's trace event format
+//
+
+static void flush_trace()
+{
+	if (Trace_file != nullptr && !Trace_buffer.empty()) {
+		x16write(Trace_file, Trace_buffer);
+		Trace_buffer.clear();
+	}
+}
+
+static void trace_event(const char *name, uint64_t start, uint64_t end)
+{
+	Trace_buffer += fmt::format("{}\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f}}}", Trace_first ? "" : ",", name, (double)(start - Trace_base) * Perf_to_us, (double)(end - start) * Perf_to_us);
+	Trace_first = false;
+	if (Trace_buffer.size() >= PROFILER_TRACE_FLUSH_SIZE) {
+		flush_trace();
+	}
+}
+
+//
+// Setup
+//
+
+bool profiler_init()
+{
+	Perf_to_us = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+	memset(&Totals, 0, sizeof(Totals));
+	memset(&Current_frame, 0, sizeof(Current_frame));
+
+	if (!Options.profile_trace_path.empty()) {
+		Trace_file = x16open(Options.profile_trace_path.generic_string().c_str(), "w");
+		if (Trace_file == nullptr) {
+			fmt::print("Cannot write profiler trace {}!\n", Options.profile_trace_path.generic_string());
+			return false;
+		}
+		x16write(Trace_file, std::string("{\"traceEvents\":["));
+		Trace_base  = SDL_GetPerformanceCounter();
+		Trace_first = true;
+		profiler_set_user(profiler_user::trace, true);
+	}
+	return true;
+}
+
+void profiler_shutdown()
+{
+	if (Trace_file != nullptr) {
+		profiler_set_user(profiler_user::trace, false);
+		Trace_buffer += "\n]}\n";
+		flush_trace();
+		x16close(Trace_file);
+		Trace_file = nullptr;
+	}
+}
+
+void profiler_set_user(profiler_user user, bool active)
+{
+	const bool was_enabled = Profiler_enabled;
+	if (active) {
+		Users |= (uint32_t)user;
+	} else {
+		Users &= ~(uint32_t)user;
+	}
+	Profiler_enabled = (Users != 0);
+
+	if (Profiler_enabled && !was_enabled) {
+		// Start over, rather than report a frame that was only partly timed.
+		memset(&Current_frame, 0, sizeof(Current_frame));
+		History.clear();
+		Frame_start = SDL_GetPerformanceCounter();
+	}
+}
+
+//
+// Collection
+//
+
+void profiler_end_frame()
+{
+	if (!Profiler_enabled) {
+		return;
+	}
+
+	const uint64_t now  = SDL_GetPerformanceCounter();
+	Current_frame.total = now - Frame_start;
+
+	Totals.total += Current_frame.total;
+	for (int i = 0; i < (int)profiler_section::count; ++i) {
+		Totals.sections[i] += Current_frame.sections[i];
+	}
+	History.add(Current_frame);
+
+	if (Trace_file != nullptr) {
+		trace_event("frame", Frame_start, now);
+	}
+
+	memset(&Current_frame, 0, sizeof(Current_frame));
+	Frame_start = now;
+}
+
+void profiler_add_time(profiler_section section, uint64_t start, uint64_t end)
+{
+	Current_frame.sections[(int)section] += end - start;
+	if (Trace_file != nullptr) {
+		trace_event(Section_names[(int)section], start, end);
+	}
+}
+
+//
+// Queries
+//
+
+const char *profiler_section_name(profiler_section section)
+{
+	return Section_names[(int)section];
+}
+
+bool profiler_section_is_top_level(profiler_section section)
+{
+	return section != profiler_section::render && section != profiler_section::ym;
+}
+
+uint64_t profiler_frame_cpu(const profiler_frame &frame)
+{
+	uint64_t cpu = frame.total;
+	for (int i = 0; i < (int)profiler_section::count; ++i) {
+		if (profiler_section_is_top_level((profiler_section)i)) {
+			cpu -= std::min(cpu, frame.sections[i]);
+		}
+	}
+	return cpu;
+}
+
+bool profiler_get_frame(uint32_t age, profiler_frame &frame)
+{
+	if (age >= History.count()) {
+		return false;
+	}
+	frame = History.get(History.count() - 1 - age);
+	return true;
+}
+
+uint32_t profiler_frame_count()
+{
+	return (uint32_t)History.count();
+}
+
+const profiler_frame &profiler_get_totals()
+{
+	return Totals;
+}
+
+double profiler_to_ms(uint64_t perf)
+{
+	return (double)perf * Perf_to_us / 1000.0;
+}
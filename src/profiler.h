@@ -0,0 +1,72 @@
+#pragma once
+#if !defined(PROFILER_H)
+#	define PROFILER_H
+
+#	include <stdint.h>
+
+#	include "timing.h"
+
+//
+// Wall-clock time per emulator subsystem, gathered by scoped timers and
+// aggregated per emulated frame. Time that no section accounts for is
+// charged to the CPU core. Some sections nest inside others (render_line
+// runs inside vera_video_step), and only count towards their parent.
+//
+
+enum class profiler_section : int {
+	video,
+	render,
+	audio,
+	ym,
+	devices,
+	display,
+	host,
+	idle,
+	count
+};
+
+#	define PROFILER_HISTORY_FRAMES (120)
+
+// Anything that wants timings registers itself, and the timers stay off when nobody does.
+enum class profiler_user : uint32_t {
+	overlay   = 1,
+	trace     = 2,
+	benchmark = 4
+};
+
+struct profiler_frame {
+	uint64_t total;
+	uint64_t sections[(int)profiler_section::count];
+};
+
+extern bool Profiler_enabled;
+
+// Opens Options.profile_trace_path, if set.
+bool profiler_init();
+void profiler_shutdown();
+
+void profiler_set_user(profiler_user user, bool active);
+
+// Call at the start of each emulated frame.
+void profiler_end_frame();
+
+void profiler_add_time(profiler_section section, uint64_t start, uint64_t end);
+
+const char *profiler_section_name(profiler_section section);
+bool        profiler_section_is_top_level(profiler_section section);
+
+// Time not spent in any top-level section.
+uint64_t profiler_frame_cpu(const profiler_frame &frame);
+
+// Recent complete frames, newest first. Returns false past the end of the history.
+bool     profiler_get_frame(uint32_t age, profiler_frame &frame);
+uint32_t profiler_frame_count();
+
+// Running totals over every frame profiled so far.
+const profiler_frame &profiler_get_totals();
+
+double profiler_to_ms(uint64_t perf);
+
+using profiler_scope = timing_scope<profiler_section, Profiler_enabled, profiler_add_time>;
+
+#endif
@@ -0,0 +1,223 @@
+#include "rewind.h"
+
+#include <string.h>
+#include <vector>
+
+#include "glue.h"
+#include "memory.h"
+#include "options.h"
+#include "ring_buffer.h"
+#include "savestate.h"
+#include "vera/vera_video.h"
+
+#define VRAM_SIZE (0x20000)
+#define VRAM_PAGE_SIZE VERA_VIDEO_VRAM_PAGE_SIZE
+
+//
+// Each frame keeps a full snapshot of the small, non-memory machine state, plus
+// the start-of-frame contents of every RAM/ROM block and VRAM page that changed
+// during that frame. The newest frame is still open, so its deltas are only
+// filled in when the next frame is captured.
+//
+// Shadow copies of RAM, ROM and VRAM hold their contents as of the start of
+// the open frame, which is where the deltas come from.
+//
+
+struct rewind_delta {
+	std::vector<uint32_t> offsets;
+	std::vector<uint8_t>  data;
+
+	void clear()
+	{
+		offsets.clear();
+		data.clear();
+	}
+};
+
+struct rewind_frame {
+	std::vector<uint8_t> state;
+	rewind_delta         ram;
+	rewind_delta         rom;
+	rewind_delta         vram;
+};
+
+static dynamic_ring_buffer<rewind_frame> *Frames = nullptr;
+
+static uint8_t *RAM_shadow      = nullptr;
+static uint8_t *ROM_shadow      = nullptr;
+static uint8_t *VRAM_shadow     = nullptr;
+static uint32_t RAM_shadow_size = 0;
+
+static std::vector<uint32_t> Dirty_ram;
+static std::vector<uint32_t> Dirty_rom;
+static std::vector<uint32_t> Dirty_vram;
+
+static void take_dirty_blocks()
+{
+	Dirty_ram.clear();
+	Dirty_rom.clear();
+	Dirty_vram.clear();
+	memory_take_dirty_blocks(Dirty_ram, Dirty_rom);
+	vera_video_take_dirty_vram_pages(Dirty_vram);
+}
+
+// Move the start-of-frame contents of each dirty block into delta, and bring the shadow up to date.
+static void record_blocks(rewind_delta &delta, const std::vector<uint32_t> &blocks, uint8_t *shadow, const uint8_t *mem)
+{
+	for (uint32_t offset : blocks) {
+		delta.offsets.push_back(offset);
+		delta.data.insert(delta.data.end(), shadow + offset, shadow + offset + MEMORY_DIRTY_BLOCK_SIZE);
+		memcpy(shadow + offset, mem + offset, MEMORY_DIRTY_BLOCK_SIZE);
+	}
+}
+
+// VERA only reports which pages were written, so pages written back to their old contents are skipped here.
+static void record_vram(rewind_delta &delta, const std::vector<uint32_t> &pages)
+{
+	uint8_t page[VRAM_PAGE_SIZE];
+	for (uint32_t offset : pages) {
+		vera_video_space_read_range(page, offset, VRAM_PAGE_SIZE);
+		if (memcmp(page, VRAM_shadow + offset, VRAM_PAGE_SIZE) != 0) {
+			delta.offsets.push_back(offset);
+			delta.data.insert(delta.data.end(), VRAM_shadow + offset, VRAM_shadow + offset + VRAM_PAGE_SIZE);
+			memcpy(VRAM_shadow + offset, page, VRAM_PAGE_SIZE);
+		}
+	}
+}
+
+// Write a delta back into the shadow, and into memory if given.
+static void apply_delta(const rewind_delta &delta, uint32_t block_size, uint8_t *shadow, uint8_t *mem)
+{
+	const uint8_t *data = delta.data.data();
+	for (uint32_t offset : delta.offsets) {
+		memcpy(shadow + offset, data, block_size);
+		if (mem != nullptr) {
+			memcpy(mem + offset, data, block_size);
+		}
+		data += block_size;
+	}
+}
+
+void rewind_init(uint32_t max_frames)
+{
+	rewind_shutdown();
+	if (max_frames == 0) {
+		return;
+	}
+
+	// One extra for the open frame.
+	Frames = new dynamic_ring_buffer<rewind_frame>(max_frames + 1);
+
+	RAM_shadow_size = 0xa000 + (uint32_t)Options.num_ram_banks * 8192;
+	RAM_shadow      = new uint8_t[RAM_shadow_size];
+	ROM_shadow      = new uint8_t[ROM_SIZE];
+	VRAM_shadow     = new uint8_t[VRAM_SIZE];
+
+	memory_set_dirty_tracking(true);
+	rewind_reset();
+}
+
+void rewind_shutdown()
+{
+	memory_set_dirty_tracking(false);
+	delete Frames;
+	delete[] RAM_shadow;
+	delete[] ROM_shadow;
+	delete[] VRAM_shadow;
+
+	Frames          = nullptr;
+	RAM_shadow      = nullptr;
+	ROM_shadow      = nullptr;
+	VRAM_shadow     = nullptr;
+	RAM_shadow_size = 0;
+}
+
+void rewind_reset()
+{
+	if (Frames == nullptr) {
+		return;
+	}
+
+	Frames->clear();
+	take_dirty_blocks();
+	memcpy(RAM_shadow, RAM, RAM_shadow_size);
+	memcpy(ROM_shadow, ROM, ROM_SIZE);
+	vera_video_space_read_range(VRAM_shadow, 0, VRAM_SIZE);
+}
+
+void rewind_capture_frame()
+{
+	if (Frames == nullptr) {
+		return;
+	}
+
+	if (Frames->count() > 0) {
+		rewind_frame &open = Frames->get_newest();
+		take_dirty_blocks();
+		record_blocks(open.ram, Dirty_ram, RAM_shadow, RAM);
+		record_blocks(open.rom, Dirty_rom, ROM_shadow, ROM);
+		record_vram(open.vram, Dirty_vram);
+	}
+
+	// Reusing the oldest frame's buffers keeps steady-state capture free of allocations.
+	rewind_frame &frame = Frames->allocate();
+	frame.ram.clear();
+	frame.rom.clear();
+	frame.vram.clear();
+	frame.state.clear();
+
+	savestate state(frame.state);
+	state.exclude_memory();
+	machine_save_restore(state);
+}
+
+bool rewind_is_enabled()
+{
+	return Frames != nullptr;
+}
+
+uint32_t rewind_available_frames()
+{
+	if (Frames == nullptr || Frames->count() == 0) {
+		return 0;
+	}
+	return (uint32_t)Frames->count() - 1;
+}
+
+bool rewind_step_back(uint32_t num_frames)
+{
+	if (Frames == nullptr || Frames->count() == 0 || num_frames > rewind_available_frames()) {
+		return false;
+	}
+
+	// Undo whatever the open frame has written so far; the shadows still hold its starting contents.
+	take_dirty_blocks();
+	for (uint32_t offset : Dirty_ram) {
+		memcpy(RAM + offset, RAM_shadow + offset, MEMORY_DIRTY_BLOCK_SIZE);
+	}
+	for (uint32_t offset : Dirty_rom) {
+		memcpy(ROM + offset, ROM_shadow + offset, MEMORY_DIRTY_BLOCK_SIZE);
+	}
+
+	// Each older frame's deltas turn the start of the next frame back into the start of that one.
+	for (uint32_t i = 0; i < num_frames; ++i) {
+		Frames->pop_newest();
+		rewind_frame &frame = Frames->get_newest();
+		apply_delta(frame.ram, MEMORY_DIRTY_BLOCK_SIZE, RAM_shadow, RAM);
+		apply_delta(frame.rom, MEMORY_DIRTY_BLOCK_SIZE, ROM_shadow, ROM);
+		apply_delta(frame.vram, VRAM_PAGE_SIZE, VRAM_shadow, nullptr);
+		frame.ram.clear();
+		frame.rom.clear();
+		frame.vram.clear();
+	}
+	vera_video_space_write_range(0, VRAM_shadow, VRAM_SIZE);
+
+	const rewind_frame &target = Frames->get_newest();
+	savestate           state(target.state.data(), target.state.size());
+	state.exclude_memory();
+	machine_save_restore(state);
+
+	// Restoring marks every VRAM page as written, but memory now matches the shadows again.
+	take_dirty_blocks();
+	return !state.failed();
+}
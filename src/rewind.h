@@ -0,0 +1,23 @@
+#pragma once
+#if !defined(REWIND_H)
+#	define REWIND_H
+
+#	include <stdint.h>
+
+// Keep up to max_frames frames of history. 0 disables rewind.
+void rewind_init(uint32_t max_frames);
+void rewind_shutdown();
+
+// Drop all history and start over from the current machine state.
+void rewind_reset();
+
+// Call at the start of each emulated frame.
+void rewind_capture_frame();
+
+bool     rewind_is_enabled();
+uint32_t rewind_available_frames();
+
+// Return the machine to the start of the frame that began num_frames frames before the current one.
+bool rewind_step_back(uint32_t num_frames);
+
+#endif
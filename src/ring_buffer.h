@@ -191,6 +191,20 @@ public:
 		// Nothing to do.
 	}
 
+	~dynamic_ring_buffer()
+	{
+		delete[] m_elems;
+	}
+
+	dynamic_ring_buffer(const dynamic_ring_buffer &) = delete;
+	dynamic_ring_buffer &operator=(const dynamic_ring_buffer &) = delete;
+
+	void clear()
+	{
+		m_oldest = 0;
+		m_count  = 0;
+	}
+
 	T &allocate()
 	{
 		const size_t index = (m_oldest + m_count) % m_size;
@@ -213,6 +227,11 @@ public:
 		return m_elems[(m_oldest + index) % m_size];
 	}
 
+	T &get(size_t index)
+	{
+		return m_elems[(m_oldest + index) % m_size];
+	}
+
 	const T &get_oldest() const
 	{
 		return m_elems[m_oldest];
@@ -233,7 +252,12 @@ public:
 		return get(m_count - !!m_count);
 	}
 
-	const T &pop_newest()
+	T &get_newest()
+	{
+		return get(m_count - !!m_count);
+	}
+
+	T &pop_newest()
 	{
 		m_count -= !!m_count;
 		return get(m_count);
@@ -261,72 +285,62 @@ private:
 	T           *m_elems;
 };
 
-template <typename T, size_t SIZE, bool ALLOW_OVERWRITE = true>
+// Lock-free ring for one producer thread and one consumer thread. The producer fills the slot
+// from allocate() and publishes it with commit(); the consumer reads get_oldest() until it calls free_oldest().
+template <typename T, size_t SIZE>
 class ring_allocator
 {
 public:
 	ring_allocator()
-	    : m_oldest(0), m_count(0)
+	    : m_head(0), m_tail(0)
 	{
 		// Nothing to do.
 	}
 
+	// Producer. Returns nullptr while the ring is full.
 	T *allocate()
 	{
-		const size_t index = (m_oldest + m_count) % SIZE;
-		if constexpr (ALLOW_OVERWRITE) {
-			if (m_count < SIZE) {
-				++m_count;
-			} else {
-				m_oldest = (m_oldest + 1) % SIZE;
-			}
-		} else {
-			if (m_count >= SIZE) {
-				return nullptr;
-			}
-			++m_count;
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) >= SIZE) {
+			return nullptr;
 		}
-		return &m_elems[index];
+		return &m_elems[head % SIZE];
 	}
 
+	// Producer. Makes the slot returned by allocate() visible to the consumer.
+	void commit()
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Consumer.
 	const T *get_oldest() const
 	{
-		if (m_count == 0) {
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (m_head.load(std::memory_order_acquire) == tail) {
 			return nullptr;
 		}
-		return &m_elems[m_oldest];
+		return &m_elems[tail % SIZE];
 	}
 
+	// Consumer.
 	void free_oldest()
 	{
-		if (m_count > 0) {
-			--m_count;
-			m_oldest = (m_oldest + 1) % SIZE;
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (m_head.load(std::memory_order_acquire) != tail) {
+			m_tail.store(tail + 1, std::memory_order_release);
 		}
 	}
 
-	const T &get(size_t index) const
-	{
-		return m_elems[(m_oldest + index) % SIZE];
-	}
-
-	const T &operator[](size_t index) const
-	{
-		return get(index);
-	}
-
-	const size_t count() const
+	// Exact on the consumer side. The producer may see slots the consumer has only just freed.
+	size_t count() const
 	{
-		return m_count;
-	}
-
-	const size_t size_remaining() const
-	{
-		return SIZE - m_count;
+		const size_t tail = m_tail.load(std::memory_order_acquire);
+		return m_head.load(std::memory_order_acquire) - tail;
 	}
 
 private:
-	std::atomic<size_t> m_oldest;
-	std::atomic<size_t> m_count;
-	T                   m_elems[SIZE];
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+	T m_elems[SIZE];
 };
@@ -10,6 +10,7 @@
 
 #include "rtc.h"
 #include "glue.h"
+#include "savestate.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <time.h>
@@ -33,7 +34,7 @@ static int          year;
 #define BCD(a) (((a) / 10) << 4 | ((a) % 10))
 #define UNBCD(a) (((a) >> 4) * 10 + ((a)&0xf))
 
-void rtc_init(bool set_system_time)
+void rtc_init(bool set_system_time, time_t now)
 {
 	vbaten = true;
 	h24    = true;
@@ -41,8 +42,7 @@ void rtc_init(bool set_system_time)
 
 	if (set_system_time) {
 		running      = true;
-		time_t    t  = time(NULL);
-		struct tm tm = *localtime(&t);
+		struct tm tm = *localtime(&now);
 		seconds      = tm.tm_sec;
 		minutes      = tm.tm_min;
 		hours        = tm.tm_hour;
@@ -223,3 +223,19 @@ void rtc_write(uint8_t a, uint8_t v)
 			}
 	}
 }
+
+void rtc_save_restore(savestate &state)
+{
+	state.save_restore(nvram);
+	state.save_restore(running);
+	state.save_restore(vbaten);
+	state.save_restore(h24);
+	state.save_restore(clocks);
+	state.save_restore(seconds);
+	state.save_restore(minutes);
+	state.save_restore(hours);
+	state.save_restore(day_of_week);
+	state.save_restore(day);
+	state.save_restore(month);
+	state.save_restore(year);
+}
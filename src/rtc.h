@@ -6,14 +6,18 @@
 #define _RTC_H_
 
 #include <stdint.h>
+#include <time.h>
 
 extern bool    nvram_dirty;
 extern uint8_t nvram[0x40];
 
-void    rtc_init(bool set_system_time);
+class savestate;
+
+void    rtc_init(bool set_system_time, time_t now);
 void    rtc_set_system_time();
 void    rtc_step(int c);
 uint8_t rtc_read(uint8_t offset);
 void    rtc_write(uint8_t offset, uint8_t value);
+void    rtc_save_restore(savestate &state);
 
 #endif
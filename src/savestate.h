@@ -0,0 +1,98 @@
+// Commander X16 Emulator
+// Copyright (c) 2023 Stephen Horn, et al.
+// All rights reserved. License: 2-clause BSD
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+// Binary machine snapshot. Each module provides a <module>_save_restore(savestate &) which
+// walks its state in a fixed order; the same function is used in both directions, the way
+// ymfm's save_restore() works. Data is stored in host layout, so snapshots are only meant
+// to be restored by the same build on the same kind of machine.
+class savestate
+{
+public:
+	// Saving appends to buffer.
+	explicit savestate(std::vector<uint8_t> &buffer)
+	    : m_buffer(&buffer),
+	      m_data(nullptr),
+	      m_size(0),
+	      m_offset(0),
+	      m_failed(false),
+	      m_exclude_memory(false)
+	{
+		// Nothing to do.
+	}
+
+	// Restoring reads from data, which must outlive this object.
+	savestate(const uint8_t *data, size_t size)
+	    : m_buffer(nullptr),
+	      m_data(data),
+	      m_size(size),
+	      m_offset(0),
+	      m_failed(false),
+	      m_exclude_memory(false)
+	{
+		// Nothing to do.
+	}
+
+	bool saving() const
+	{
+		return m_buffer != nullptr;
+	}
+
+	// True if a restore ran past the end of the snapshot.
+	bool failed() const
+	{
+		return m_failed;
+	}
+
+	// True once a restore has consumed the whole snapshot.
+	bool finished() const
+	{
+		return !saving() && m_offset == m_size;
+	}
+
+	void save_restore(void *data, size_t size)
+	{
+		if (saving()) {
+			const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+			m_buffer->insert(m_buffer->end(), bytes, bytes + size);
+		} else if (m_failed || m_offset + size > m_size) {
+			m_failed = true;
+		} else {
+			memcpy(data, m_data + m_offset, size);
+			m_offset += size;
+		}
+	}
+
+	// Leave RAM, ROM and VRAM out of the snapshot, for callers that track those separately.
+	void exclude_memory()
+	{
+		m_exclude_memory = true;
+	}
+
+	bool memory_excluded() const
+	{
+		return m_exclude_memory;
+	}
+
+	template <typename T>
+	void save_restore(T &data)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "savestate can only copy trivially copyable types");
+		save_restore(&data, sizeof(T));
+	}
+
+private:
+	std::vector<uint8_t> *m_buffer;
+	const uint8_t        *m_data;
+	size_t                m_size;
+	size_t                m_offset;
+	bool                  m_failed;
+	bool                  m_exclude_memory;
+};
@@ -6,8 +6,8 @@
 #include "display.h"
 #include "glue.h"
 #include "imgui/imgui_impl_sdl2.h"
+#include "input_replay.h"
 #include "joystick.h"
-#include "keyboard.h"
 #include "options.h"
 #include "overlay/overlay.h"
 #include "i2c.h"
@@ -85,11 +85,11 @@ bool sdl_events_update()
 								consumed = true;
 								break;
 							case SDLK_r:
-								machine_reset();
+								input_replay_reset();
 								consumed = true;
 								break;
 							case SDLK_v:
-								keyboard_add_text(SDL_GetClipboardText());
+								input_replay_text(SDL_GetClipboardText());
 								consumed = true;
 								break;
 							case SDLK_f:
@@ -158,7 +158,7 @@ bool sdl_events_update()
 					}
 				}
 				if (!consumed) {
-					keyboard_add_event(true, event.key.keysym.scancode);
+					input_replay_key(true, event.key.keysym.scancode);
 				}
 				break;
 			}
@@ -170,20 +170,20 @@ bool sdl_events_update()
 				if (event.key.keysym.scancode == SDL_SCANCODE_LALT || event.key.keysym.scancode == SDL_SCANCODE_RALT) {
 					alt_down = false;
 				}
-				keyboard_add_event(false, event.key.keysym.scancode);
+				input_replay_key(false, event.key.keysym.scancode);
 				break;
 
 			case SDL_MOUSEBUTTONDOWN:
 				mouse_state_change = true;
 				switch (event.button.button) {
 					case SDL_BUTTON_LEFT:
-						mouse_button_down(0);
+						input_replay_mouse_button(0, true);
 						break;
 					case SDL_BUTTON_RIGHT:
-						mouse_button_down(1);
+						input_replay_mouse_button(1, true);
 						break;
 					case SDL_BUTTON_MIDDLE:
-						mouse_button_down(2);
+						input_replay_mouse_button(2, true);
 						break;
 				}
 				break;
@@ -192,13 +192,13 @@ bool sdl_events_update()
 				mouse_state_change = true;
 				switch (event.button.button) {
 					case SDL_BUTTON_LEFT:
-						mouse_button_up(0);
+						input_replay_mouse_button(0, false);
 						break;
 					case SDL_BUTTON_RIGHT:
-						mouse_button_up(1);
+						input_replay_mouse_button(1, false);
 						break;
 					case SDL_BUTTON_MIDDLE:
-						mouse_button_up(2);
+						input_replay_mouse_button(2, false);
 						break;
 				}
 				break;
@@ -219,7 +219,7 @@ bool sdl_events_update()
 				mouse_state_change = true;
 				if (mouse_captured) {
 					// send mouse move as-is, no scaling applied
-					mouse_move(event.motion.xrel, event.motion.yrel);
+					input_replay_mouse_move(event.motion.xrel, event.motion.yrel);
 				} else {
 					// send mouse move from the last position, syncing with host cursor as much as possible
 					float new_x = event.motion.x - display_rect.x;
@@ -228,7 +228,7 @@ bool sdl_events_update()
 					new_y = std::min(std::max(new_y, 0.f), display_rect.w) / display_rect.w * 480.f;
 					int new_x_i = (int)new_x;
 					int new_y_i = (int)new_y;
-					mouse_move(new_x_i - last_x, new_y_i - last_y);
+					input_replay_mouse_move(new_x_i - last_x, new_y_i - last_y);
 					last_x = new_x_i;
 					last_y = new_y_i;
 				}
@@ -243,7 +243,7 @@ bool sdl_events_update()
 	display_refund_render_time(event_handling_end_us - event_handling_start_us);
 
 	if (mouse_state_change) {
-		mouse_send_state();
+		input_replay_mouse_send();
 	}
 	return true;
 }
@@ -9,6 +9,7 @@
 #include "keyboard.h"
 
 #include "glue.h"
+#include "savestate.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -69,3 +70,9 @@ void smc_write(uint8_t a, uint8_t v)
 			break;
 	}
 }
+
+void smc_save_restore(savestate &state)
+{
+	state.save_restore(power_led);
+	state.save_restore(activity_led);
+}
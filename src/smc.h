@@ -10,7 +10,10 @@
 extern uint8_t power_led;
 extern uint8_t activity_led;
 
+class savestate;
+
 uint8_t smc_read(uint8_t offset);
 void    smc_write(uint8_t offset, uint8_t value);
+void    smc_save_restore(savestate &state);
 
 #endif
@@ -1,10 +1,12 @@
 #include "timing.h"
 
 #include <SDL.h>
+#include <algorithm>
 
 #include "glue.h"
 #include "options.h"
 #include "ring_buffer.h"
+#include "vera/vera_video.h"
 
 struct tick_record {
 	uint32_t us;
@@ -28,13 +30,61 @@ static uint64_t Performance_frequency;
 
 static constexpr uint32_t Expected_frametime_us = 1000000 / 60;
 
+// Adaptive frameskip doesn't try to make up for longer stalls than this, like file dialogs.
+static constexpr uint32_t Frameskip_max_debt_us = Expected_frametime_us * 4;
+
+uint32_t        Timing_skipped_frames = 0;
+static uint32_t Frameskip_debt_us     = 0;
+static uint32_t Frameskip_run         = 0;
+
 static uint32_t perf_to_us(const uint64_t perf)
 {
 	return (uint32_t)(1000000 * perf / Performance_frequency);
 }
 
+//
+// Adaptive frameskip
+//
+// A frame that runs over its time slot leaves a debt. Later frames pay it back out of the
+// time they would have slept, and while any is still owed, frames skip drawing the way warp
+// mode's cheat mask does, up to Options.frameskip in a row.
+//
+
+// Returns how much of the debt this frame's spare time went towards.
+static uint32_t frameskip_update(const uint32_t us_elapsed, const bool throttled)
+{
+	if (!throttled || Options.frameskip <= 0) {
+		Frameskip_debt_us = 0;
+		Frameskip_run     = 0;
+		vera_video_set_skip_frame(false);
+		return 0;
+	}
+
+	uint32_t us_repaid = 0;
+	if (us_elapsed > Expected_frametime_us) {
+		Frameskip_debt_us = std::min(Frameskip_debt_us + (us_elapsed - Expected_frametime_us), Frameskip_max_debt_us);
+	} else {
+		us_repaid = std::min(Frameskip_debt_us, Expected_frametime_us - us_elapsed);
+		Frameskip_debt_us -= us_repaid;
+	}
+
+	const bool skip = Frameskip_debt_us > 0 && Frameskip_run < (uint32_t)Options.frameskip;
+	if (skip) {
+		Frameskip_run++;
+		Timing_skipped_frames++;
+	} else {
+		Frameskip_run = 0;
+	}
+	vera_video_set_skip_frame(skip);
+	return us_repaid;
+}
+
 void timing_init()
 {
+	Frameskip_debt_us = 0;
+	Frameskip_run     = 0;
+	vera_video_set_skip_frame(false);
+
 	Total_frames          = 0;
 	Base_performance_time = SDL_GetPerformanceCounter();
 	Last_performance_time = Base_performance_time;
@@ -55,8 +105,10 @@ void timing_update()
 	tick_record        tick            = { perf_to_us(tick_perf_diff), perf_to_us(total_perf_diff), Total_frames };
 
 	const uint32_t us_elapsed = tick.total_us - last_tick.total_us;
-	if (Options.warp_factor == 0 && us_elapsed < Expected_frametime_us) { // 60 fps
-		usleep(Expected_frametime_us - us_elapsed);
+	const bool     throttled  = Options.warp_factor == 0 && !Options.headless;
+	const uint32_t us_repaid  = frameskip_update(us_elapsed, throttled);
+	if (throttled && us_elapsed + us_repaid < Expected_frametime_us) { // 60 fps
+		usleep(Expected_frametime_us - us_elapsed - us_repaid);
 
 		const uint64_t current_performance_time = SDL_GetPerformanceCounter();
 		const uint64_t tick_perf_diff           = current_performance_time - Last_performance_time;
@@ -76,6 +128,9 @@ void timing_update()
 		fmt::print("Speed: {:d}%\n", Timing_perf);
 		uint32_t load = (uint32_t)(100 * tick.us / Expected_frametime_us);
 		fmt::print("Load: {:d}%\n", load > 100 ? 100 : load);
+		if (Options.frameskip > 0) {
+			fmt::print("Skipped: {:d}\n", Timing_skipped_frames);
+		}
 	}
 
 	Last_performance_time = current_performance_time;
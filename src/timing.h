@@ -2,11 +2,38 @@
 #if !defined(TIMING_H)
 #	define TIMING_H
 
+#	include <SDL_timer.h>
+#	include <stdint.h>
+
 extern uint32_t Timing_perf;
+extern uint32_t Timing_skipped_frames;
 
 void timing_init();
 void timing_update();
 uint32_t timing_total_microseconds();
 uint32_t timing_total_microseconds_realtime();
 
+// Hands the performance-counter interval of its lifetime to ADD, if ENABLED was set when it opened.
+template <typename SECTION, bool &ENABLED, void (*ADD)(SECTION, uint64_t, uint64_t)>
+class timing_scope
+{
+public:
+	timing_scope(SECTION section)
+	    : m_section(section),
+	      m_start(ENABLED ? SDL_GetPerformanceCounter() : 0)
+	{
+	}
+
+	~timing_scope()
+	{
+		if (m_start != 0) {
+			ADD(m_section, m_start, SDL_GetPerformanceCounter());
+		}
+	}
+
+private:
+	SECTION  m_section;
+	uint64_t m_start;
+};
+
 #endif
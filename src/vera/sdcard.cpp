@@ -16,6 +16,7 @@
 #include "files.h"
 
 #include "hypercalls.h"
+#include "savestate.h"
 
 // #define VERBOSE 1
 
@@ -62,6 +63,9 @@ static int            response_counter = 0;
 
 static bool selected = false;
 
+// A restored response in flight can't point back into the set_response_*() statics.
+static uint8_t restored_response[2 + 512 + 2];
+
 void sdcard_shutdown()
 {
 	if (sdcard_attached) {
@@ -128,6 +132,35 @@ void sdcard_select(bool select)
 #endif
 }
 
+void sdcard_save_restore(savestate &state)
+{
+	state.save_restore(rxbuf);
+	state.save_restore(rxbuf_idx);
+	state.save_restore(lba);
+	state.save_restore(last_cmd);
+	state.save_restore(is_acmd);
+	state.save_restore(is_idle);
+	state.save_restore(is_initialized);
+	state.save_restore(selected);
+
+	bool has_response = (response != nullptr);
+	state.save_restore(has_response);
+	state.save_restore(response_length);
+	state.save_restore(response_counter);
+	if (has_response) {
+		if (state.saving()) {
+			state.save_restore(const_cast<uint8_t *>(response), response_length);
+		} else if (response_length <= (int)sizeof(restored_response)) {
+			state.save_restore(restored_response, response_length);
+			response = restored_response;
+		} else {
+			response = nullptr;
+		}
+	} else if (!state.saving()) {
+		response = nullptr;
+	}
+}
+
 static void set_response_r1(void)
 {
 	static uint8_t r1;
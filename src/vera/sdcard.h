@@ -4,6 +4,8 @@
 #ifndef SD_CARD_H
 #define SD_CARD_H
 
+class savestate;
+
 void sdcard_shutdown();
 void sdcard_set_file(char const *path);
 bool sdcard_path_is_set();
@@ -13,5 +15,6 @@ bool sdcard_is_attached();
 
 void    sdcard_select(bool select);
 uint8_t sdcard_handle(uint8_t inbyte);
+void    sdcard_save_restore(savestate &state);
 
 #endif
@@ -5,7 +5,7 @@
 #include "vera_pcm.h"
 #include <stdio.h>
 
-#include "audio.h"
+#include "savestate.h"
 
 static uint8_t  fifo[4096 - 1]; // Actual hardware FIFO is 4kB, but you can only use 4095 bytes.
 static unsigned fifo_wridx;
@@ -42,6 +42,19 @@ void pcm_reset(void)
 	phase = 0;
 }
 
+void pcm_save_restore(savestate &state)
+{
+	state.save_restore(fifo);
+	state.save_restore(fifo_wridx);
+	state.save_restore(fifo_rdidx);
+	state.save_restore(fifo_cnt);
+	state.save_restore(ctrl);
+	state.save_restore(rate);
+	state.save_restore(cur_l);
+	state.save_restore(cur_r);
+	state.save_restore(phase);
+}
+
 void pcm_write_ctrl(uint8_t val)
 {
 	if (val & 0x80) {
@@ -15,7 +15,10 @@ struct pcm_debug_info {
 	unsigned maxsiz;
 };
 
+class savestate;
+
 void           pcm_reset(void);
+void           pcm_save_restore(savestate &state);
 void           pcm_write_ctrl(uint8_t val);
 uint8_t        pcm_read_ctrl(void);
 void           pcm_write_rate(uint8_t val);
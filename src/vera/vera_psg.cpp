@@ -5,158 +5,314 @@
 #include "vera_psg.h"
 
 #include <stdbool.h>
-#include <stdlib.h>
 #include <string.h>
 
-#include "audio.h"
+#include "savestate.h"
 
-static psg_channel Channels[PSG_NUM_CHANNELS];
+// The renderer advances all channels at once, with whatever vector unit the compiler targets, and plain C++ otherwise.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define PSG_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define PSG_SIMD_NEON
+#endif
+
+// Channel state, one lane per channel. Left and right are all-ones masks.
+struct psg_lanes {
+	uint32_t phase[PSG_NUM_CHANNELS];
+	uint32_t freq[PSG_NUM_CHANNELS];
+	uint32_t pw[PSG_NUM_CHANNELS];
+	uint32_t waveform[PSG_NUM_CHANNELS];
+	uint32_t volume[PSG_NUM_CHANNELS];
+	uint32_t left[PSG_NUM_CHANNELS];
+	uint32_t right[PSG_NUM_CHANNELS];
+	uint32_t noiseval[PSG_NUM_CHANNELS];
+};
+
+alignas(16) static psg_lanes Lanes;
+
+// The noise source is a 16-bit LFSR (new bit = bit 1 ^ bit 2 ^ bit 4 ^ bit 15), stepped once per channel
+// per sample like the VERA's sequential channel update. The step is linear, so the 16 steps of a sample
+// are taken at once by xoring together the jump of each state byte.
+static uint16_t Noise_state = 1;
+static uint16_t Noise_jump[2][256];
+static bool     Noise_jump_built = false;
+
+// For psg_get_channel, which reports the lanes in the layout the debugger expects.
+static psg_channel Channel_view[PSG_NUM_CHANNELS];
 
 static uint8_t volume_lut[64] = { 0, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 6, 6, 7, 7, 7, 8, 8, 9, 9, 10, 11, 11, 12, 13, 14, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 28, 29, 31, 33, 35, 37, 39, 42, 44, 47, 50, 52, 56, 59, 63 };
 
+//
+// Noise
+//
+
+static uint16_t noise_step(uint16_t state)
+{
+	return (uint16_t)((state << 1) | (((state >> 1) ^ (state >> 2) ^ (state >> 4) ^ (state >> 15)) & 1));
+}
+
+static void noise_build_jump()
+{
+	for (int b = 0; b < 2; ++b) {
+		for (int value = 0; value < 256; ++value) {
+			uint16_t state = (uint16_t)(value << (b * 8));
+			for (int i = 0; i < PSG_NUM_CHANNELS; ++i) {
+				state = noise_step(state);
+			}
+			Noise_jump[b][value] = state;
+		}
+	}
+	Noise_jump_built = true;
+}
+
+// The value each channel would latch this sample, if its phase wraps.
+static void noise_generate(uint32_t *values)
+{
+	const uint32_t prev = Noise_state;
+	const uint32_t next = Noise_jump[0][prev & 0xff] ^ Noise_jump[1][prev >> 8];
+
+	// Each step shifts one new bit in at the bottom, so the state after k steps is the 16 bits of
+	// this history starting at bit 16 - k. Channel i steps first and then latches bits 1-6 of the
+	// state (k = i + 1), which start at bit 16 - (i + 1) + 1 = 16 - i.
+	const uint32_t history = (prev << 16) | next;
+	for (int i = 0; i < PSG_NUM_CHANNELS; ++i) {
+		values[i] = (history >> (16 - i)) & 0x3f;
+	}
+	Noise_state = (uint16_t)next;
+}
+
+//
+// Registers
+//
+
 void psg_reset(void)
 {
-	audio_lock_scope lock;
-	memset(Channels, 0, sizeof(Channels));
+	if (!Noise_jump_built) {
+		noise_build_jump();
+	}
+	memset(&Lanes, 0, sizeof(Lanes));
+	Noise_state = 1;
+}
+
+void psg_save_restore(savestate &state)
+{
+	state.save_restore(Lanes);
+	state.save_restore(Noise_state);
 }
 
 void psg_writereg(uint8_t reg, uint8_t val)
 {
-	audio_lock_scope lock;
 	reg &= 0x3f;
 
 	int ch  = reg / 4;
 	int idx = reg & 3;
 
 	switch (idx) {
-		case 0: Channels[ch].freq = (Channels[ch].freq & 0xFF00) | val; break;
-		case 1: Channels[ch].freq = (Channels[ch].freq & 0x00FF) | (val << 8); break;
+		case 0: Lanes.freq[ch] = (Lanes.freq[ch] & 0xFF00) | val; break;
+		case 1: Lanes.freq[ch] = (Lanes.freq[ch] & 0x00FF) | (val << 8); break;
 		case 2: {
-			Channels[ch].right  = (val & 0x80) != 0;
-			Channels[ch].left   = (val & 0x40) != 0;
-			Channels[ch].volume = volume_lut[val & 0x3F];
+			Lanes.right[ch]  = (val & 0x80) ? ~0u : 0;
+			Lanes.left[ch]   = (val & 0x40) ? ~0u : 0;
+			Lanes.volume[ch] = volume_lut[val & 0x3F];
 			break;
 		}
 		case 3: {
-			Channels[ch].pw       = val & 0x3F;
-			Channels[ch].waveform = val >> 6;
+			Lanes.pw[ch]       = val & 0x3F;
+			Lanes.waveform[ch] = val >> 6;
 			break;
 		}
 	}
 }
 
-static void render(int16_t *left, int16_t *right)
+//
+// Rendering
+//
+
+// Each channel's phase advances by its frequency, and the waveform is read from the top bits of the phase:
+//   pulse:    63 while (phase >> 10) <= pw, else 0
+//   sawtooth: phase >> 11
+//   triangle: (phase >> 10) & 0x3f, mirrored in the upper half of the period
+//   noise:    a new LFSR value latched whenever bit 16 of the phase changes
+// The 6-bit sample is made signed (v - 32) and scaled by the volume.
+static void render(int16_t *out, const uint32_t *noise)
 {
-	int l = 0;
-	int r = 0;
+#if defined(PSG_SIMD_SSE2)
+	const __m128i phase_mask = _mm_set1_epi32(0x1FFFF);
+	const __m128i half       = _mm_set1_epi32(0x10000);
+	const __m128i six_bits   = _mm_set1_epi32(0x3F);
+	const __m128i bias       = _mm_set1_epi32(0x20);
 
-	for (int i = 0; i < PSG_NUM_CHANNELS; i++) {
-		struct psg_channel *ch = &Channels[i];
+	__m128i l = _mm_setzero_si128();
+	__m128i r = _mm_setzero_si128();
+	for (int i = 0; i < PSG_NUM_CHANNELS; i += 4) {
+		const __m128i phase     = _mm_load_si128((const __m128i *)(Lanes.phase + i));
+		const __m128i new_phase = _mm_and_si128(_mm_add_epi32(phase, _mm_load_si128((const __m128i *)(Lanes.freq + i))), phase_mask);
+		const __m128i wrapped   = _mm_cmpeq_epi32(_mm_and_si128(_mm_xor_si128(phase, new_phase), half), half);
+		const __m128i noiseval  = _mm_or_si128(_mm_and_si128(wrapped, _mm_loadu_si128((const __m128i *)(noise + i))), _mm_andnot_si128(wrapped, _mm_load_si128((const __m128i *)(Lanes.noiseval + i))));
+		_mm_store_si128((__m128i *)(Lanes.phase + i), new_phase);
+		_mm_store_si128((__m128i *)(Lanes.noiseval + i), noiseval);
 
-		unsigned new_phase = (ch->phase + ch->freq) & 0x1FFFF;
-		if ((ch->phase & 0x10000) != (new_phase & 0x10000)) {
-			ch->noiseval = rand() & 63;
-		}
-		ch->phase = new_phase;
-
-		uint8_t v = 0;
-		switch (ch->waveform) {
-			case WF_PULSE: v = (ch->phase >> 10) > ch->pw ? 0 : 63; break;
-			case WF_SAWTOOTH: v = ch->phase >> 11; break;
-			case WF_TRIANGLE: v = (ch->phase & 0x10000) ? (~(ch->phase >> 10) & 0x3F) : ((ch->phase >> 10) & 0x3F); break;
-			case WF_NOISE: v = ch->noiseval; break;
-		}
-		int8_t sv = (v ^ 0x20);
-		if (sv & 0x20) {
-			sv |= 0xC0;
-		}
+		const __m128i top      = _mm_srli_epi32(new_phase, 10);
+		const __m128i upper    = _mm_cmpeq_epi32(_mm_and_si128(new_phase, half), half);
+		const __m128i pulse    = _mm_andnot_si128(_mm_cmpgt_epi32(top, _mm_load_si128((const __m128i *)(Lanes.pw + i))), six_bits);
+		const __m128i sawtooth = _mm_srli_epi32(new_phase, 11);
+		const __m128i triangle = _mm_and_si128(_mm_xor_si128(top, _mm_and_si128(upper, six_bits)), six_bits);
 
-		int val = (int)sv * (int)ch->volume;
+		const __m128i waveform = _mm_load_si128((const __m128i *)(Lanes.waveform + i));
+		__m128i       v        = _mm_and_si128(_mm_cmpeq_epi32(waveform, _mm_set1_epi32(WF_PULSE)), pulse);
+		v                      = _mm_or_si128(v, _mm_and_si128(_mm_cmpeq_epi32(waveform, _mm_set1_epi32(WF_SAWTOOTH)), sawtooth));
+		v                      = _mm_or_si128(v, _mm_and_si128(_mm_cmpeq_epi32(waveform, _mm_set1_epi32(WF_TRIANGLE)), triangle));
+		v                      = _mm_or_si128(v, _mm_and_si128(_mm_cmpeq_epi32(waveform, _mm_set1_epi32(WF_NOISE)), noiseval));
 
-		if (ch->left) {
-			l += val;
-		}
-		if (ch->right) {
-			r += val;
-		}
+		// Both factors fit in the low 16 bits of each lane, and the volume's high half is zero.
+		const __m128i val = _mm_madd_epi16(_mm_sub_epi32(v, bias), _mm_load_si128((const __m128i *)(Lanes.volume + i)));
+		l                 = _mm_add_epi32(l, _mm_and_si128(val, _mm_load_si128((const __m128i *)(Lanes.left + i))));
+		r                 = _mm_add_epi32(r, _mm_and_si128(val, _mm_load_si128((const __m128i *)(Lanes.right + i))));
 	}
+	__m128i sum = _mm_add_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+	sum         = _mm_add_epi32(sum, _mm_srli_si128(sum, 8));
+	out[0]      = (int16_t)_mm_cvtsi128_si32(sum);
+	out[1]      = (int16_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 4));
+#elif defined(PSG_SIMD_NEON)
+	const uint32x4_t phase_mask = vdupq_n_u32(0x1FFFF);
+	const uint32x4_t half       = vdupq_n_u32(0x10000);
+	const uint32x4_t six_bits   = vdupq_n_u32(0x3F);
+	const int32x4_t  bias       = vdupq_n_s32(0x20);
+
+	int32x4_t l = vdupq_n_s32(0);
+	int32x4_t r = vdupq_n_s32(0);
+	for (int i = 0; i < PSG_NUM_CHANNELS; i += 4) {
+		const uint32x4_t phase     = vld1q_u32(Lanes.phase + i);
+		const uint32x4_t new_phase = vandq_u32(vaddq_u32(phase, vld1q_u32(Lanes.freq + i)), phase_mask);
+		const uint32x4_t wrapped   = vtstq_u32(veorq_u32(phase, new_phase), half);
+		const uint32x4_t noiseval  = vbslq_u32(wrapped, vld1q_u32(noise + i), vld1q_u32(Lanes.noiseval + i));
+		vst1q_u32(Lanes.phase + i, new_phase);
+		vst1q_u32(Lanes.noiseval + i, noiseval);
+
+		const uint32x4_t top      = vshrq_n_u32(new_phase, 10);
+		const uint32x4_t upper    = vtstq_u32(new_phase, half);
+		const uint32x4_t pulse    = vbicq_u32(six_bits, vcgtq_u32(top, vld1q_u32(Lanes.pw + i)));
+		const uint32x4_t sawtooth = vshrq_n_u32(new_phase, 11);
+		const uint32x4_t triangle = vandq_u32(veorq_u32(top, vandq_u32(upper, six_bits)), six_bits);
+
+		const uint32x4_t waveform = vld1q_u32(Lanes.waveform + i);
+		uint32x4_t       v        = vandq_u32(vceqq_u32(waveform, vdupq_n_u32(WF_PULSE)), pulse);
+		v                         = vorrq_u32(v, vandq_u32(vceqq_u32(waveform, vdupq_n_u32(WF_SAWTOOTH)), sawtooth));
+		v                         = vorrq_u32(v, vandq_u32(vceqq_u32(waveform, vdupq_n_u32(WF_TRIANGLE)), triangle));
+		v                         = vorrq_u32(v, vandq_u32(vceqq_u32(waveform, vdupq_n_u32(WF_NOISE)), noiseval));
+
+		const int32x4_t val = vmulq_s32(vsubq_s32(vreinterpretq_s32_u32(v), bias), vreinterpretq_s32_u32(vld1q_u32(Lanes.volume + i)));
+		l                   = vaddq_s32(l, vandq_s32(val, vreinterpretq_s32_u32(vld1q_u32(Lanes.left + i))));
+		r                   = vaddq_s32(r, vandq_s32(val, vreinterpretq_s32_u32(vld1q_u32(Lanes.right + i))));
+	}
+	const int32x2_t sum = vpadd_s32(vadd_s32(vget_low_s32(l), vget_high_s32(l)), vadd_s32(vget_low_s32(r), vget_high_s32(r)));
+	out[0]              = (int16_t)vget_lane_s32(sum, 0);
+	out[1]              = (int16_t)vget_lane_s32(sum, 1);
+#else
+	int l = 0;
+	int r = 0;
+	for (int i = 0; i < PSG_NUM_CHANNELS; ++i) {
+		const uint32_t phase     = Lanes.phase[i];
+		const uint32_t new_phase = (phase + Lanes.freq[i]) & 0x1FFFF;
+		const uint32_t wrapped   = 0u - (((phase ^ new_phase) >> 16) & 1);
+		const uint32_t noiseval  = (noise[i] & wrapped) | (Lanes.noiseval[i] & ~wrapped);
+		Lanes.phase[i]           = new_phase;
+		Lanes.noiseval[i]        = noiseval;
+
+		const uint32_t top      = new_phase >> 10;
+		const uint32_t upper    = 0u - ((new_phase >> 16) & 1);
+		const uint32_t pulse    = (0u - (uint32_t)(top <= Lanes.pw[i])) & 0x3F;
+		const uint32_t sawtooth = new_phase >> 11;
+		const uint32_t triangle = (top ^ (upper & 0x3F)) & 0x3F;
+
+		const uint32_t waveform = Lanes.waveform[i];
+		const uint32_t v        = ((0u - (uint32_t)(waveform == WF_PULSE)) & pulse) | ((0u - (uint32_t)(waveform == WF_SAWTOOTH)) & sawtooth) | ((0u - (uint32_t)(waveform == WF_TRIANGLE)) & triangle) | ((0u - (uint32_t)(waveform == WF_NOISE)) & noiseval);
 
-	*left  = l;
-	*right = r;
+		const int val = ((int)v - 0x20) * (int)Lanes.volume[i];
+		l += val & (int)Lanes.left[i];
+		r += val & (int)Lanes.right[i];
+	}
+	out[0] = (int16_t)l;
+	out[1] = (int16_t)r;
+#endif
 }
 
 void psg_render(int16_t *buf, unsigned int num_samples)
 {
+	alignas(16) uint32_t noise[PSG_NUM_CHANNELS];
 	while (num_samples--) {
-		render(&buf[0], &buf[1]);
+		noise_generate(noise);
+		render(buf, noise);
 		buf += 2;
 	}
 }
 
-const psg_channel *psg_get_channel(unsigned int channel)
-{
-	audio_lock_scope lock;
-	if (channel > PSG_NUM_CHANNELS) {
-		return nullptr;
-	}
-
-	return &Channels[channel];
-}
+//
+// Debugger access
+//
 
-psg_channel *psg_get_channel_debug(unsigned int channel)
+const psg_channel *psg_get_channel(unsigned int channel)
 {
-	audio_lock_scope lock;
 	if (channel >= PSG_NUM_CHANNELS) {
 		return nullptr;
 	}
 
-	return &Channels[channel];
+	psg_channel &view = Channel_view[channel];
+	view.freq         = (uint16_t)Lanes.freq[channel];
+	view.volume       = (uint8_t)Lanes.volume[channel];
+	view.left         = Lanes.left[channel] != 0;
+	view.right        = Lanes.right[channel] != 0;
+	view.pw           = (uint8_t)Lanes.pw[channel];
+	view.waveform     = (uint8_t)Lanes.waveform[channel];
+	view.phase        = Lanes.phase[channel];
+	view.noiseval     = (uint8_t)Lanes.noiseval[channel];
+	return &view;
 }
 
+//
+// Direct channel control
+//
+
 void psg_set_channel_frequency(unsigned int channel, uint16_t freq)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].freq = freq;
+		Lanes.freq[channel] = freq;
 	}
 }
 
 void psg_set_channel_left(unsigned int channel, bool left)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].left = left;
+		Lanes.left[channel] = left ? ~0u : 0;
 	}
 }
 
 void psg_set_channel_right(unsigned int channel, bool right)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].right = right;
+		Lanes.right[channel] = right ? ~0u : 0;
 	}
 }
 
 void psg_set_channel_volume(unsigned int channel, uint8_t volume)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].volume = volume & 0x3f;
+		Lanes.volume[channel] = volume & 0x3f;
 	}
 }
 
 void psg_set_channel_waveform(unsigned int channel, uint8_t waveform)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].waveform = waveform;
+		Lanes.waveform[channel] = waveform;
 	}
 }
 
 void psg_set_channel_pulse_width(unsigned int channel, uint8_t pw)
 {
-	audio_lock_scope lock;
 	if (channel < PSG_NUM_CHANNELS) {
-		Channels[channel].pw = pw & 0x3f;
+		Lanes.pw[channel] = pw & 0x3f;
 	}
 }
@@ -26,12 +26,14 @@ struct psg_channel {
 	uint8_t  noiseval;
 };
 
+class savestate;
+
 void psg_reset(void);
+void psg_save_restore(savestate &state);
 void psg_writereg(uint8_t reg, uint8_t val);
 void psg_render(int16_t *buf, unsigned int num_samples);
 
 const psg_channel *psg_get_channel(unsigned int channel);
-psg_channel *      psg_get_channel_debug(unsigned int channel);
 
 void psg_set_channel_frequency(unsigned int channel, uint16_t freq);
 void psg_set_channel_left(unsigned int channel, bool left);
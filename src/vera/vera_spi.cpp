@@ -9,6 +9,7 @@
 #include <stdio.h>
 
 #include "cpu/fake6502.h"
+#include "savestate.h"
 
 bool    ss;
 bool    busy;
@@ -16,6 +17,8 @@ bool    autotx;
 uint8_t sending_byte, received_byte;
 int     outcounter;
 
+static uint64_t autostep_clocks = 0;
+
 void vera_spi_init()
 {
 	ss            = false;
@@ -26,9 +29,21 @@ void vera_spi_init()
 
 void vera_spi_autostep()
 {
-	static uint64_t clocks = 0;
-	vera_spi_step((int)(clockticks6502 - clocks));
-	clocks = clockticks6502;
+	vera_spi_step((int)(clockticks6502 - autostep_clocks));
+	autostep_clocks = clockticks6502;
+}
+
+void vera_spi_save_restore(savestate &state)
+{
+	state.save_restore(ss);
+	state.save_restore(busy);
+	state.save_restore(autotx);
+	state.save_restore(sending_byte);
+	state.save_restore(received_byte);
+	state.save_restore(outcounter);
+	state.save_restore(autostep_clocks);
+
+	sdcard_save_restore(state);
 }
 
 void vera_spi_step(int clocks)
@@ -4,7 +4,10 @@
 
 #include <inttypes.h>
 
+class savestate;
+
 void    vera_spi_init();
+void    vera_spi_save_restore(savestate &state);
 void    vera_spi_step(int clocks);
 uint8_t debug_vera_spi_read(uint8_t reg);
 uint8_t vera_spi_read(uint8_t address);
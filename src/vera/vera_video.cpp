@@ -10,16 +10,36 @@
 #include "vera_psg.h"
 #include "vera_spi.h"
 #include "files.h"
+#include "profiler.h"
+#include "savestate.h"
 
 #include <algorithm>
 #include <limits.h>
 #include <cstring>
 #include <cmath>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #ifdef __EMSCRIPTEN__
 #	include "emscripten.h"
 #endif
 
+// Pixel kernels use whatever vector unit the compiler targets, and plain C++ otherwise.
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define VERA_SIMD_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define VERA_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define VERA_SIMD_NEON
+#endif
+
 #define ADDR_VRAM_START 0x00000
 #define ADDR_VRAM_END 0x20000
 #define ADDR_PSG_START 0x1F9C0
@@ -33,18 +53,25 @@
 
 // both VGA and NTSC
 #define SCAN_HEIGHT 525
-#define PIXEL_FREQ 25.0f
+#define PIXEL_FREQ 25
+
+// Scan positions count ticks of a 200MHz reference clock, which both the
+// 25MHz pixel clock and the 8MHz CPU clock divide into evenly.
+#define SCAN_TICK_FREQ 200
+#define SCAN_TICKS_PER_PIXEL (SCAN_TICK_FREQ / PIXEL_FREQ)
 
 // VGA
 #define VGA_SCAN_WIDTH 800
 #define VGA_X_OFFSET 0
 #define VGA_Y_OFFSET 0
+#define VGA_LINE_TICKS (VGA_SCAN_WIDTH * SCAN_TICKS_PER_PIXEL)
 
 // NTSC: 262.5 lines per frame, lower field first
 #define NTSC_HALF_SCAN_WIDTH 794
 #define NTSC_X_OFFSET 270
 #define NTSC_Y_OFFSET_LOW 42
 #define NTSC_Y_OFFSET_HIGH 568
+#define NTSC_HALF_LINE_TICKS (NTSC_HALF_SCAN_WIDTH * SCAN_TICKS_PER_PIXEL)
 #define TITLE_SAFE_X 0.067
 #define TITLE_SAFE_Y 0.05
 
@@ -89,13 +116,14 @@ static uint8_t sprite_line_collisions;
 static bool    layer_line_enable[2];
 static bool    sprite_line_enable;
 
-static float    vga_scan_pos_x;
+static uint32_t vga_scan_pos_x; // in scan ticks
 static uint16_t vga_scan_pos_y;
-static float    ntsc_half_cnt;
+static uint32_t ntsc_half_cnt; // in scan ticks
 static uint16_t ntsc_scan_pos_y;
 
-static int frame_count = 0;
-static int cheat_mask  = 0;
+static int  frame_count = 0;
+static int  cheat_mask  = 0;
+static bool skip_frame  = false;
 
 static bool log_video              = false;
 static bool shadow_safety_frame[4] = { false, false, true, true };
@@ -159,14 +187,191 @@ static const uint8_t vera_version_string[] = {'V',
 
 static uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT * 4];
 
+//
+// Line cache
+//
+// Each rendered line remembers the registers it was drawn with and which VRAM pages it read.
+// VRAM writes stamp their page, so a line whose registers match and whose pages haven't been
+// written since can keep last frame's framebuffer row. The palette and sprite attributes live
+// in VRAM too, so they're covered the same way.
+//
+
+#define LINE_CACHE_PAGE_SHIFT 9
+#define LINE_CACHE_PAGES (0x20000 >> LINE_CACHE_PAGE_SHIFT)
+#define LINE_CACHE_REGS 23
+
+struct line_cache_line {
+	uint64_t stamp;
+	uint64_t read_pages[LINE_CACHE_PAGES / 64];
+	uint8_t  regs[LINE_CACHE_REGS];
+	uint8_t  collisions;
+	bool     valid;
+};
+
+struct line_cache {
+	uint64_t        stamp;
+	uint64_t        page_stamps[LINE_CACHE_PAGES];
+	uint64_t        reading[LINE_CACHE_PAGES / 64];
+	line_cache_line lines[SCREEN_HEIGHT];
+};
+
+static line_cache Live_cache;
+
+static_assert(VERA_VIDEO_VRAM_PAGE_SIZE == (1 << LINE_CACHE_PAGE_SHIFT));
+
+// Live_cache stamp when vera_video_take_dirty_vram_pages() last ran.
+static uint64_t Dirty_vram_stamp = 0;
+
+static std::atomic<uint64_t> Lines_reused;
+static std::atomic<uint64_t> Lines_rendered;
+
+static void line_cache_invalidate(line_cache *cache)
+{
+	for (line_cache_line &line : cache->lines) {
+		line.valid = false;
+	}
+	// Anything else checked against the page stamps, like decoded sprite rows, goes too.
+	for (uint64_t &page_stamp : cache->page_stamps) {
+		page_stamp = cache->stamp;
+	}
+}
+
+static void line_cache_write(line_cache *cache, uint32_t address)
+{
+	cache->page_stamps[(address & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT] = cache->stamp;
+}
+
+static void line_cache_mark(line_cache *cache, uint32_t address)
+{
+	const uint32_t page = (address & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT;
+	cache->reading[page >> 6] |= 1ull << (page & 63);
+}
+
+static void line_cache_mark_range(line_cache *cache, uint32_t address, uint32_t size)
+{
+	if (size == 0) {
+		return;
+	}
+	uint32_t       page = (address & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT;
+	const uint32_t last = ((address + size - 1) & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT;
+	for (;;) {
+		cache->reading[page >> 6] |= 1ull << (page & 63);
+		if (page == last) {
+			break;
+		}
+		page = (page + 1) % LINE_CACHE_PAGES;
+	}
+}
+
+static bool line_cache_is_clean(const line_cache *cache, const line_cache_line &line)
+{
+	for (int i = 0; i < LINE_CACHE_PAGES / 64; ++i) {
+		uint64_t pages = line.read_pages[i];
+		while (pages != 0) {
+			const int bit = std::countr_zero(pages);
+			if (cache->page_stamps[i * 64 + bit] >= line.stamp) {
+				return false;
+			}
+			pages &= pages - 1;
+		}
+	}
+	return true;
+}
+
+static bool line_cache_range_is_clean(const line_cache *cache, uint32_t address, uint32_t size, uint64_t stamp)
+{
+	uint32_t       page = (address & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT;
+	const uint32_t last = ((address + size - 1) & 0x1FFFF) >> LINE_CACHE_PAGE_SHIFT;
+	for (;;) {
+		if (cache->page_stamps[page] >= stamp) {
+			return false;
+		}
+		if (page == last) {
+			break;
+		}
+		page = (page + 1) % LINE_CACHE_PAGES;
+	}
+	return true;
+}
+
+//
+// Sprite cache
+//
+// Each line has a bitmask of the sprites that cover it, kept up to date as sprite attributes
+// change, so render_sprite_line() never looks at sprites it won't draw. Decoded sprite rows
+// are stamped like scanlines, and stay valid until a VRAM write touches the page they came from.
+//
+
+// Sprite Y is 10 bits, so no sprite reaches past this line.
+#define SPRITE_CACHE_LINES 1024
+
+struct sprite_cache {
+	uint64_t lines[SPRITE_CACHE_LINES][NUM_SPRITES / 64];
+	uint32_t keys[NUM_SPRITES];
+	uint64_t row_stamps[NUM_SPRITES][64];
+	uint8_t  rows[NUM_SPRITES][64][64];
+};
+
+static sprite_cache Live_sprites;
+
+static void sprite_cache_set_lines(sprite_cache *sprites, uint8_t sprite, const vera_video_sprite_properties *props, bool present)
+{
+	if (props->sprite_zdepth == 0) {
+		return;
+	}
+
+	const int      first = std::max((int)props->sprite_y, 0);
+	const int      last  = std::min((int)props->sprite_y + props->sprite_height, SPRITE_CACHE_LINES);
+	const uint64_t bit   = 1ull << (sprite & 63);
+	for (int y = first; y < last; ++y) {
+		if (present) {
+			sprites->lines[y][sprite >> 6] |= bit;
+		} else {
+			sprites->lines[y][sprite >> 6] &= ~bit;
+		}
+	}
+}
+
+//
+// Tile cache
+//
+// Tiles are decoded whole to 8bpp, once as stored and once mirrored for HFLIP, so tile layers
+// render as row copies. Tiles are aligned to their size, which is never more than a page, so
+// one page stamp covers each tile. Changing the layer's tile layout throws everything away.
+//
+
+#define TILE_CACHE_TILES 1024
+#define TILE_CACHE_TILE_SIZE (16 * 16)
+
+struct tile_cache {
+	uint32_t layout;
+	uint64_t stamps[2][TILE_CACHE_TILES];
+	uint8_t  pixels[2][TILE_CACHE_TILES * TILE_CACHE_TILE_SIZE];
+};
+
+static tile_cache Live_tiles[2];
+
+static void tile_cache_set_layout(tile_cache *tiles, const vera_video_layer_properties *props)
+{
+	const uint32_t layout = props->tile_base | props->color_depth << 17 | props->tilew_log2 << 19 | props->tileh_log2 << 22;
+	if (tiles->layout != layout) {
+		tiles->layout = layout;
+		memset(tiles->stamps, 0, sizeof(tiles->stamps));
+	}
+}
+
 static const uint16_t default_palette[] = {
 	0x000, 0xfff, 0x800, 0xafe, 0xc4c, 0x0c5, 0x00a, 0xee7, 0xd85, 0x640, 0xf77, 0x333, 0x777, 0xaf6, 0x08f, 0xbbb, 0x000, 0x111, 0x222, 0x333, 0x444, 0x555, 0x666, 0x777, 0x888, 0x999, 0xaaa, 0xbbb, 0xccc, 0xddd, 0xeee, 0xfff, 0x211, 0x433, 0x644, 0x866, 0xa88, 0xc99, 0xfbb, 0x211, 0x422, 0x633, 0x844, 0xa55, 0xc66, 0xf77, 0x200, 0x411, 0x611, 0x822, 0xa22, 0xc33, 0xf33, 0x200, 0x400, 0x600, 0x800, 0xa00, 0xc00, 0xf00, 0x221, 0x443, 0x664, 0x886, 0xaa8, 0xcc9, 0xfeb, 0x211, 0x432, 0x653, 0x874, 0xa95, 0xcb6, 0xfd7, 0x210, 0x431, 0x651, 0x862, 0xa82, 0xca3, 0xfc3, 0x210, 0x430, 0x640, 0x860, 0xa80, 0xc90, 0xfb0, 0x121, 0x343, 0x564, 0x786, 0x9a8, 0xbc9, 0xdfb, 0x121, 0x342, 0x463, 0x684, 0x8a5, 0x9c6, 0xbf7, 0x120, 0x241, 0x461, 0x582, 0x6a2, 0x8c3, 0x9f3, 0x120, 0x240, 0x360, 0x480, 0x5a0, 0x6c0, 0x7f0, 0x121, 0x343, 0x465, 0x686, 0x8a8, 0x9ca, 0xbfc, 0x121, 0x242, 0x364, 0x485, 0x5a6, 0x6c8, 0x7f9, 0x020, 0x141, 0x162, 0x283, 0x2a4, 0x3c5, 0x3f6, 0x020, 0x041, 0x061, 0x082, 0x0a2, 0x0c3, 0x0f3, 0x122, 0x344, 0x466, 0x688, 0x8aa, 0x9cc, 0xbff, 0x122, 0x244, 0x366, 0x488, 0x5aa, 0x6cc, 0x7ff, 0x022, 0x144, 0x166, 0x288, 0x2aa, 0x3cc, 0x3ff, 0x022, 0x044, 0x066, 0x088, 0x0aa, 0x0cc, 0x0ff, 0x112, 0x334, 0x456, 0x668, 0x88a, 0x9ac, 0xbcf, 0x112, 0x224, 0x346, 0x458, 0x56a, 0x68c, 0x79f, 0x002, 0x114, 0x126, 0x238, 0x24a, 0x35c, 0x36f, 0x002, 0x014, 0x016, 0x028, 0x02a, 0x03c, 0x03f, 0x112, 0x334, 0x546, 0x768, 0x98a, 0xb9c, 0xdbf, 0x112, 0x324, 0x436, 0x648, 0x85a, 0x96c, 0xb7f, 0x102, 0x214, 0x416, 0x528, 0x62a, 0x83c, 0x93f, 0x102, 0x204, 0x306, 0x408, 0x50a, 0x60c, 0x70f, 0x212, 0x434, 0x646, 0x868, 0xa8a, 0xc9c, 0xfbe, 0x211, 0x423, 0x635, 0x847, 0xa59, 0xc6b, 0xf7d, 0x201, 0x413, 0x615, 0x826, 0xa28, 0xc3a, 0xf3c, 0x201, 0x403, 0x604, 0x806, 0xa08, 0xc09, 0xf0b
 };
 
 static void refresh_palette();
+static void render_thread_wait();
+static void render_thread_resync();
 
 void vera_video_reset()
 {
+	render_thread_wait();
+
 	// init I/O registers
 	memset(io_addr, 0, sizeof(io_addr));
 	memset(io_inc, 0, sizeof(io_inc));
@@ -258,6 +463,9 @@ void vera_video_reset()
 
 	psg_reset();
 	pcm_reset();
+
+	line_cache_invalidate(&Live_cache);
+	render_thread_resync();
 }
 
 struct vera_video_layer_properties layer_properties[2];
@@ -284,24 +492,19 @@ static uint32_t calc_layer_map_offset_base2(const struct vera_video_layer_proper
 //{
 //	return props->map_base + ((eff_y / props->tileh) * props->mapw + (eff_x / props->tilew)) * 2;
 // }
-static void refresh_layer_properties(const uint8_t layer)
+static void refresh_layer_properties(struct vera_video_layer_properties *props, const uint8_t *regs)
 {
-	struct vera_video_layer_properties *props = &layer_properties[layer];
-
-	uint16_t prev_layerw_max = props->layerw_max;
-	uint16_t prev_hscroll    = props->hscroll;
-
-	props->color_depth    = reg_layer[layer][0] & 0x3;
-	props->map_base       = reg_layer[layer][1] << 9;
-	props->tile_base      = (reg_layer[layer][2] & 0xFC) << 9;
-	props->bitmap_mode    = (reg_layer[layer][0] & 0x4) != 0;
+	props->color_depth    = regs[0] & 0x3;
+	props->map_base       = regs[1] << 9;
+	props->tile_base      = (regs[2] & 0xFC) << 9;
+	props->bitmap_mode    = (regs[0] & 0x4) != 0;
 	props->text_mode      = (props->color_depth == 0) && !props->bitmap_mode;
-	props->text_mode_256c = (reg_layer[layer][0] & 8) != 0;
+	props->text_mode_256c = (regs[0] & 8) != 0;
 	props->tile_mode      = !props->bitmap_mode && !props->text_mode;
 
 	if (!props->bitmap_mode) {
-		props->hscroll = reg_layer[layer][3] | (reg_layer[layer][4] & 0xf) << 8;
-		props->vscroll = reg_layer[layer][5] | (reg_layer[layer][6] & 0xf) << 8;
+		props->hscroll = regs[3] | (regs[4] & 0xf) << 8;
+		props->vscroll = regs[5] | (regs[6] & 0xf) << 8;
 	} else {
 		props->hscroll = 0;
 		props->vscroll = 0;
@@ -313,19 +516,19 @@ static void refresh_layer_properties(const uint8_t layer)
 	props->tileh  = 0;
 
 	if (props->tile_mode || props->text_mode) {
-		props->mapw_log2 = 5 + ((reg_layer[layer][0] >> 4) & 3);
-		props->maph_log2 = 5 + ((reg_layer[layer][0] >> 6) & 3);
+		props->mapw_log2 = 5 + ((regs[0] >> 4) & 3);
+		props->maph_log2 = 5 + ((regs[0] >> 6) & 3);
 		mapw             = 1 << props->mapw_log2;
 		maph             = 1 << props->maph_log2;
 
 		// Scale the tiles or text characters according to TILEW and TILEH.
-		props->tilew_log2 = 3 + (reg_layer[layer][2] & 1);
-		props->tileh_log2 = 3 + ((reg_layer[layer][2] >> 1) & 1);
+		props->tilew_log2 = 3 + (regs[2] & 1);
+		props->tileh_log2 = 3 + ((regs[2] >> 1) & 1);
 		props->tilew      = 1 << props->tilew_log2;
 		props->tileh      = 1 << props->tileh_log2;
 	} else if (props->bitmap_mode) {
 		// bitmap mode is basically tiled mode with a single huge tile
-		props->tilew = (reg_layer[layer][2] & 1) ? 640 : 320;
+		props->tilew = (regs[2] & 1) ? 640 : 320;
 		props->tileh = SCREEN_HEIGHT;
 	}
 
@@ -347,19 +550,22 @@ static void refresh_layer_properties(const uint8_t layer)
 	props->color_fields_max = (8 >> props->color_depth) - 1;
 }
 
+static void refresh_layer_properties(const uint8_t layer)
+{
+	refresh_layer_properties(&layer_properties[layer], reg_layer[layer]);
+}
+
 vera_video_sprite_properties sprite_properties[128];
 
-static void refresh_sprite_properties(const uint16_t sprite)
+static void refresh_sprite_properties(struct vera_video_sprite_properties *props, const uint8_t *data)
 {
-	struct vera_video_sprite_properties *props = &sprite_properties[sprite];
+	props->sprite_zdepth         = (data[6] >> 2) & 3;
+	props->sprite_collision_mask = data[6] & 0xf0;
 
-	props->sprite_zdepth         = (sprite_data[sprite][6] >> 2) & 3;
-	props->sprite_collision_mask = sprite_data[sprite][6] & 0xf0;
-
-	props->sprite_x           = sprite_data[sprite][2] | (sprite_data[sprite][3] & 3) << 8;
-	props->sprite_y           = sprite_data[sprite][4] | (sprite_data[sprite][5] & 3) << 8;
-	props->sprite_width_log2  = (((sprite_data[sprite][7] >> 4) & 3) + 3);
-	props->sprite_height_log2 = ((sprite_data[sprite][7] >> 6) + 3);
+	props->sprite_x           = data[2] | (data[3] & 3) << 8;
+	props->sprite_y           = data[4] | (data[5] & 3) << 8;
+	props->sprite_width_log2  = (((data[7] >> 4) & 3) + 3);
+	props->sprite_height_log2 = ((data[7] >> 6) + 3);
 	props->sprite_width       = 1 << props->sprite_width_log2;
 	props->sprite_height      = 1 << props->sprite_height_log2;
 
@@ -371,26 +577,40 @@ static void refresh_sprite_properties(const uint16_t sprite)
 		props->sprite_y -= 0x400;
 	}
 
-	props->hflip = sprite_data[sprite][6] & 1;
-	props->vflip = (sprite_data[sprite][6] >> 1) & 1;
+	props->hflip = data[6] & 1;
+	props->vflip = (data[6] >> 1) & 1;
+
+	props->color_mode     = (data[1] >> 7) & 1;
+	props->sprite_address = data[0] << 5 | (data[1] & 0xf) << 13;
+
+	props->palette_offset = (data[7] & 0x0f) << 4;
+}
 
-	props->color_mode     = (sprite_data[sprite][1] >> 7) & 1;
-	props->sprite_address = sprite_data[sprite][0] << 5 | (sprite_data[sprite][1] & 0xf) << 13;
+// Also moves the sprite between line buckets, so every change to sprite properties must come through here.
+static void refresh_sprite_properties(struct vera_video_sprite_properties *props, sprite_cache *sprites, uint8_t sprite, const uint8_t *data)
+{
+	sprite_cache_set_lines(sprites, sprite, props, false);
+	refresh_sprite_properties(props, data);
+	sprite_cache_set_lines(sprites, sprite, props, true);
+}
 
-	props->palette_offset = (sprite_data[sprite][7] & 0x0f) << 4;
+static void refresh_sprite_properties(const uint16_t sprite)
+{
+	refresh_sprite_properties(&sprite_properties[sprite], &Live_sprites, (uint8_t)sprite, sprite_data[sprite]);
 }
 
 struct video_palette_props {
 	uint32_t entries[256];
+	uint32_t version;
 	bool     dirty;
 };
 
 struct video_palette_props video_palette;
 
-static void refresh_palette()
+static void refresh_palette(struct video_palette_props *props, const uint8_t *palette, uint8_t dc_video)
 {
-	const uint8_t out_mode       = reg_composer[0] & 3;
-	const bool    chroma_disable = (reg_composer[0] >> 2) & 1;
+	const uint8_t out_mode       = dc_video & 3;
+	const bool    chroma_disable = (dc_video >> 2) & 1;
 	for (int i = 0; i < 256; ++i) {
 		uint8_t r;
 		uint8_t g;
@@ -411,13 +631,167 @@ static void refresh_palette()
 			}
 		}
 
-		video_palette.entries[i] = 0xff000000 | (uint32_t)(r << 16) | ((uint32_t)g << 8) | ((uint32_t)b);
+		props->entries[i] = 0xff000000 | (uint32_t)(r << 16) | ((uint32_t)g << 8) | ((uint32_t)b);
 	}
-	video_palette.dirty = false;
+	++props->version;
+	props->dirty = false;
+}
+
+static void refresh_palette()
+{
+	refresh_palette(&video_palette, palette, reg_composer[0]);
 }
 
+//
+// Indexed output
+//
+// Lines keep their color indices, plus which palette slot and safety frame they were drawn
+// with, and the display does the lookup. Each palette that gets used goes into the next slot
+// of a ring, which holds more than a frame's worth of lines. Cached lines can outlive a trip
+// around the ring, so wrapping invalidates them.
+//
+
+static bool     Indexed_output = false;
+static uint8_t  Indexed_pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+static uint8_t  Indexed_lines[SCREEN_HEIGHT * 4];
+static uint32_t Palette_slots[VERA_VIDEO_PALETTE_SLOTS][256];
+
+static const video_palette_props *Palette_slot_source   = nullptr;
+static uint32_t                   Palette_slot_version  = 0;
+static uint16_t                   Palette_slot          = 0;
+static uint16_t                   Palette_slots_first   = 0;
+static uint16_t                   Palette_slots_changed = 0;
+
+// Set once a line has gone to the indexed buffer but not to the ARGB framebuffer.
+static bool Framebuffer_stale = false;
+
+static void palette_slot_store(line_cache *cache, const video_palette_props *props)
+{
+	Palette_slot_source  = props;
+	Palette_slot_version = props->version;
+	if (memcmp(Palette_slots[Palette_slot], props->entries, sizeof(props->entries)) == 0) {
+		return;
+	}
+
+	Palette_slot = (Palette_slot + 1) % VERA_VIDEO_PALETTE_SLOTS;
+	if (Palette_slot == 0) {
+		line_cache_invalidate(cache);
+	}
+	memcpy(Palette_slots[Palette_slot], props->entries, sizeof(props->entries));
+
+	if (Palette_slots_changed == 0) {
+		Palette_slots_first = Palette_slot;
+	}
+	if (Palette_slots_changed < VERA_VIDEO_PALETTE_SLOTS) {
+		++Palette_slots_changed;
+	}
+}
+
+static uint8_t safety_frame_mode(bool safety_frame, uint16_t y)
+{
+	if (!safety_frame) {
+		return VERA_VIDEO_SAFETY_NONE;
+	}
+	if (y < SCREEN_HEIGHT * TITLE_SAFE_Y || y > SCREEN_HEIGHT * (1 - TITLE_SAFE_Y)) {
+		return VERA_VIDEO_SAFETY_LINE;
+	}
+	return VERA_VIDEO_SAFETY_EDGES;
+}
+
+static void darken_safety_frame(uint32_t *line, uint8_t mode)
+{
+	if (mode == VERA_VIDEO_SAFETY_NONE) {
+		return;
+	}
+	for (uint16_t x = 0; x < SCREEN_WIDTH; x++) {
+		if (mode == VERA_VIDEO_SAFETY_LINE ||
+		    x < SCREEN_WIDTH * TITLE_SAFE_X ||
+		    x > SCREEN_WIDTH * (1 - TITLE_SAFE_X)) {
+
+			// Divide RGB elements by 4.
+			line[x] &= 0x00fcfcfc;
+			line[x] >>= 2;
+		}
+	}
+}
+
+//
+// Render sources
+//
+
+// Everything render_line() reads. The CPU thread renders straight from the live registers,
+// while the render thread works from its own copy, kept in step by the VRAM write log.
+struct render_source {
+	const uint8_t                      *video_ram;
+	const uint8_t                      *palette;
+	const uint8_t                      *composer;
+	const uint8_t                     (*layer)[7];
+	const vera_video_layer_properties  *layer_properties;
+	const vera_video_sprite_properties *sprite_properties;
+	video_palette_props                *video_palette;
+	line_cache                         *cache;
+	sprite_cache                       *sprites;
+	tile_cache                         *tiles;
+	bool                                cheat_frame;
+	bool                                safety_frame;
+};
+
+static uint8_t render_read(const render_source &src, uint32_t address)
+{
+	line_cache_mark(src.cache, address);
+	return src.video_ram[address & 0x1FFFF];
+}
+
+static void render_read_range(const render_source &src, uint8_t *dest, uint32_t address, uint32_t size)
+{
+	line_cache_mark_range(src.cache, address, size);
+	address &= 0x1FFFF;
+	if (address >= ADDR_VRAM_START && (address + size) <= ADDR_VRAM_END) {
+		memcpy(dest, &src.video_ram[address], size);
+	} else {
+		const uint32_t tail_size = ADDR_VRAM_END - address;
+		memcpy(dest, &src.video_ram[address], tail_size);
+		const uint32_t head_size = ((address + size) & 0x1FFFF);
+		memcpy(dest + tail_size, src.video_ram, head_size);
+	}
+}
+
+//
+// Pixel kernels
+//
+
 static void expand_1bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 {
+#if defined(VERA_SIMD_SSE2)
+	// Spread each byte over 8 lanes and test one bit per lane, 16 pixels at a time.
+	const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i ones = _mm_set1_epi8(1);
+	while (dst_size >= 16) {
+		__m128i v = _mm_cvtsi32_si128(src[0] | (src[1] << 8));
+		v         = _mm_unpacklo_epi8(v, v);
+		v         = _mm_unpacklo_epi16(v, v);
+		v         = _mm_unpacklo_epi32(v, v);
+		v         = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+		_mm_storeu_si128((__m128i *)dst, _mm_and_si128(v, ones));
+
+		src += 2;
+		dst += 16;
+		dst_size -= 16;
+	}
+#elif defined(VERA_SIMD_NEON)
+	static const uint8_t bit_values[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+
+	const uint8x8_t bits = vld1_u8(bit_values);
+	const uint8x8_t ones = vdup_n_u8(1);
+	while (dst_size >= 8) {
+		vst1_u8(dst, vand_u8(vtst_u8(vdup_n_u8(*src), bits), ones));
+
+		++src;
+		dst += 8;
+		dst_size -= 8;
+	}
+#endif
+
 	dst += 7;
 	while (dst_size >= 8) {
 		uint8_t s = *src;
@@ -453,6 +827,46 @@ static void expand_1bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 
 static void expand_2bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 {
+#if defined(VERA_SIMD_SSE2)
+	// Pull out each of the four pixel positions, then interleave them back into order, 64 pixels at a time.
+	const __m128i mask = _mm_set1_epi8(0x03);
+	while (dst_size >= 64) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)src);
+		const __m128i a = _mm_and_si128(_mm_srli_epi16(s, 6), mask);
+		const __m128i b = _mm_and_si128(_mm_srli_epi16(s, 4), mask);
+		const __m128i c = _mm_and_si128(_mm_srli_epi16(s, 2), mask);
+		const __m128i d = _mm_and_si128(s, mask);
+
+		const __m128i ab_lo = _mm_unpacklo_epi8(a, b);
+		const __m128i ab_hi = _mm_unpackhi_epi8(a, b);
+		const __m128i cd_lo = _mm_unpacklo_epi8(c, d);
+		const __m128i cd_hi = _mm_unpackhi_epi8(c, d);
+		_mm_storeu_si128((__m128i *)(dst + 0), _mm_unpacklo_epi16(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(ab_hi, cd_hi));
+		_mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(ab_hi, cd_hi));
+
+		src += 16;
+		dst += 64;
+		dst_size -= 64;
+	}
+#elif defined(VERA_SIMD_NEON)
+	const uint8x16_t mask = vdupq_n_u8(0x03);
+	while (dst_size >= 64) {
+		const uint8x16_t s = vld1q_u8(src);
+		uint8x16x4_t     px;
+		px.val[0] = vshrq_n_u8(s, 6);
+		px.val[1] = vandq_u8(vshrq_n_u8(s, 4), mask);
+		px.val[2] = vandq_u8(vshrq_n_u8(s, 2), mask);
+		px.val[3] = vandq_u8(s, mask);
+		vst4q_u8(dst, px);
+
+		src += 16;
+		dst += 64;
+		dst_size -= 64;
+	}
+#endif
+
 	dst += 3;
 	while (dst_size >= 4) {
 		uint8_t s = *src;
@@ -476,6 +890,34 @@ static void expand_2bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 
 static void expand_4bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 {
+#if defined(VERA_SIMD_SSE2)
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	while (dst_size >= 32) {
+		const __m128i s  = _mm_loadu_si128((const __m128i *)src);
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(s, 4), mask);
+		const __m128i lo = _mm_and_si128(s, mask);
+		_mm_storeu_si128((__m128i *)(dst + 0), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(hi, lo));
+
+		src += 16;
+		dst += 32;
+		dst_size -= 32;
+	}
+#elif defined(VERA_SIMD_NEON)
+	const uint8x16_t mask = vdupq_n_u8(0x0f);
+	while (dst_size >= 32) {
+		const uint8x16_t s = vld1q_u8(src);
+		uint8x16x2_t     px;
+		px.val[0] = vshrq_n_u8(s, 4);
+		px.val[1] = vandq_u8(s, mask);
+		vst2q_u8(dst, px);
+
+		src += 16;
+		dst += 32;
+		dst_size -= 32;
+	}
+#endif
+
 	while (dst_size >= 2) {
 		*dst = (*src) >> 4;
 		++dst;
@@ -487,86 +929,264 @@ static void expand_4bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
 	}
 }
 
-static void render_sprite_line(const uint16_t y)
+template <uint8_t bpp>
+static void expand_bpp_data(uint8_t *dst, const uint8_t *src, int dst_size)
+{
+	switch (bpp) {
+		case 0: expand_1bpp_data(dst, src, dst_size); break;
+		case 1: expand_2bpp_data(dst, src, dst_size); break;
+		case 2: expand_4bpp_data(dst, src, dst_size); break;
+		case 3: memcpy(dst, src, dst_size); break;
+	}
+}
+
+// Colors 1-15 get the palette offset, plus bit 7 in T256C mode. Color 0 and colors from 16 up are left alone.
+static void apply_palette_offset(uint8_t *line, int size, uint8_t palette_offset, bool t256c)
+{
+	const uint8_t add = palette_offset | (t256c ? 0x80 : 0);
+	if (add == 0) {
+		return;
+	}
+
+#if defined(VERA_SIMD_SSE2)
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128i max   = _mm_set1_epi8(15);
+	const __m128i add_v = _mm_set1_epi8((char)add);
+	while (size >= 16) {
+		const __m128i col      = _mm_loadu_si128((const __m128i *)line);
+		const __m128i in_range = _mm_andnot_si128(_mm_cmpeq_epi8(col, zero), _mm_cmpeq_epi8(_mm_min_epu8(col, max), col));
+		_mm_storeu_si128((__m128i *)line, _mm_or_si128(col, _mm_and_si128(in_range, add_v)));
+
+		line += 16;
+		size -= 16;
+	}
+#elif defined(VERA_SIMD_NEON)
+	const uint8x16_t max   = vdupq_n_u8(15);
+	const uint8x16_t add_v = vdupq_n_u8(add);
+	while (size >= 16) {
+		const uint8x16_t col      = vld1q_u8(line);
+		const uint8x16_t in_range = vandq_u8(vtstq_u8(col, col), vcleq_u8(col, max));
+		vst1q_u8(line, vorrq_u8(col, vandq_u8(in_range, add_v)));
+
+		line += 16;
+		size -= 16;
+	}
+#endif
+
+	for (int i = 0; i < size; ++i) {
+		if (line[i] > 0 && line[i] < 16) {
+			line[i] |= add;
+		}
+	}
+}
+
+static void palette_lookup(uint32_t *dst, const uint8_t *src, const uint32_t *entries, int size)
+{
+#if defined(VERA_SIMD_AVX2)
+	while (size >= 8) {
+		const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+		_mm256_storeu_si256((__m256i *)dst, _mm256_i32gather_epi32((const int *)entries, index, 4));
+
+		src += 8;
+		dst += 8;
+		size -= 8;
+	}
+#endif
+
+	while (size >= 4) {
+		dst[0] = entries[src[0]];
+		dst[1] = entries[src[1]];
+		dst[2] = entries[src[2]];
+		dst[3] = entries[src[3]];
+
+		src += 4;
+		dst += 4;
+		size -= 4;
+	}
+	while (size > 0) {
+		*dst++ = entries[*src++];
+		--size;
+	}
+}
+
+// Writes every source pixel twice, for HSCALE 64.
+static void double_pixels(uint8_t *dst, const uint8_t *src, int src_size)
+{
+#if defined(VERA_SIMD_SSE2)
+	while (src_size >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(v, v));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(v, v));
+
+		src += 16;
+		dst += 32;
+		src_size -= 16;
+	}
+#elif defined(VERA_SIMD_NEON)
+	while (src_size >= 16) {
+		const uint8x16_t v = vld1q_u8(src);
+		vst1q_u8(dst, vzip1q_u8(v, v));
+		vst1q_u8(dst + 16, vzip2q_u8(v, v));
+
+		src += 16;
+		dst += 32;
+		src_size -= 16;
+	}
+#endif
+
+	while (src_size > 0) {
+		dst[0] = *src;
+		dst[1] = *src;
+
+		++src;
+		dst += 2;
+		--src_size;
+	}
+}
+
+// Decoded 8bpp pixels for one row of a sprite, from the cache when the VRAM behind it hasn't changed.
+static const uint8_t *sprite_cache_row(const render_source &src, uint8_t sprite, const vera_video_sprite_properties *props, uint16_t row, uint16_t width)
+{
+	sprite_cache *const sprites = src.sprites;
+
+	const uint32_t key = props->sprite_address | props->color_mode << 17 | props->sprite_width_log2 << 18;
+	if (sprites->keys[sprite] != key) {
+		sprites->keys[sprite] = key;
+		memset(sprites->row_stamps[sprite], 0, sizeof(sprites->row_stamps[sprite]));
+	}
+
+	const uint32_t address = props->sprite_address + (row << (props->sprite_width_log2 - (1 - props->color_mode)));
+	const uint32_t size    = width >> (1 - props->color_mode);
+	uint8_t *const pixels  = sprites->rows[sprite][row];
+	uint64_t      &stamp   = sprites->row_stamps[sprite][row];
+	if (stamp != 0 && line_cache_range_is_clean(src.cache, address, size, stamp)) {
+		line_cache_mark_range(src.cache, address, size);
+		return pixels;
+	}
+
+	// Fetch through render_read_range(), so that sprites near the top of VRAM wrap around like any other fetch.
+	uint8_t bitmap_data[64];
+	render_read_range(src, bitmap_data, address, size);
+	if (props->color_mode == 0) {
+		// 4bpp
+		expand_4bpp_data(pixels, bitmap_data, width);
+	} else {
+		// 8bpp
+		memcpy(pixels, bitmap_data, width);
+	}
+	stamp = src.cache->stamp;
+	return pixels;
+}
+
+static void render_sprite_line(const render_source &src, const uint16_t y)
 {
 	memset(sprite_line_col, 0, SCREEN_WIDTH);
 	memset(sprite_line_z, 0, SCREEN_WIDTH);
 	memset(sprite_line_mask, 0, SCREEN_WIDTH);
 
+	if (y >= SPRITE_CACHE_LINES) {
+		return;
+	}
+
 	uint16_t sprite_budget = 800 + 1;
-	for (int i = 0; i < NUM_SPRITES; i++) {
-		// one clock per lookup
-		sprite_budget--;
-		if (sprite_budget == 0)
-			break;
-		const vera_video_sprite_properties *props = &sprite_properties[i];
+	int      looked_up     = 0;
+	for (int word = 0; word < NUM_SPRITES / 64; ++word) {
+		uint64_t line_sprites = src.sprites->lines[y][word];
+		while (line_sprites != 0) {
+			const int i = word * 64 + std::countr_zero(line_sprites);
+			line_sprites &= line_sprites - 1;
+
+			// one clock per lookup, including the sprites passed over on the way here
+			const int lookups = i + 1 - looked_up;
+			if (sprite_budget <= lookups) {
+				return;
+			}
+			sprite_budget -= lookups;
+			looked_up = i + 1;
 
-		if (props->sprite_zdepth == 0) {
-			continue;
-		}
+			const vera_video_sprite_properties *props = &src.sprite_properties[i];
 
-		// check whether this line falls within the sprite
-		if (y < props->sprite_y || y >= props->sprite_y + props->sprite_height) {
-			continue;
-		}
+			const uint16_t eff_sy = props->vflip ? ((props->sprite_height - 1) - (y - props->sprite_y)) : (y - props->sprite_y);
 
-		const uint16_t eff_sy = props->vflip ? ((props->sprite_height - 1) - (y - props->sprite_y)) : (y - props->sprite_y);
+			const uint16_t width = std::min((uint32_t)props->sprite_width, (uint32_t)64);
 
-		const uint8_t *bitmap_data = video_ram + props->sprite_address + (eff_sy << (props->sprite_width_log2 - (1 - props->color_mode)));
+			const uint8_t *const unpacked_sprite_line = sprite_cache_row(src, (uint8_t)i, props, eff_sy, width);
 
-		const uint16_t width = std::min((uint32_t)props->sprite_width, (uint32_t)64);
-		uint8_t        unpacked_sprite_line[64];
-		if (props->color_mode == 0) {
-			// 4bpp
-			expand_4bpp_data(unpacked_sprite_line, bitmap_data, width);
-		} else {
-			// 8bpp
-			memcpy(unpacked_sprite_line, bitmap_data, width);
-		}
+			const int32_t scale          = src.composer[1];
+			const int16_t scaled_x_start = scale ? ((int32_t)props->sprite_x << 7) / scale : (props->sprite_x ? SCREEN_WIDTH : 0);
+			const int16_t scaled_x_end   = scale ? scaled_x_start + (((int32_t)width << 7) / scale) : SCREEN_WIDTH;
+			const bool    hflip          = props->hflip;
+			for (int16_t sx = scaled_x_start; sx < scaled_x_end; sx += 1) {
+				if ((uint16_t)sx >= SCREEN_WIDTH) {
+					continue;
+				}
 
-		const int32_t scale          = reg_composer[1];
-		const int16_t scaled_x_start = scale ? ((int32_t)props->sprite_x << 7) / scale : (props->sprite_x ? SCREEN_WIDTH : 0);
-		const int16_t scaled_x_end   = scale ? scaled_x_start + (((int32_t)width << 7) / scale) : SCREEN_WIDTH;
-		const bool    hflip          = props->hflip;
-		for (int16_t sx = scaled_x_start; sx < scaled_x_end; sx += 1) {
-			if ((uint16_t)sx >= SCREEN_WIDTH) {
-				continue;
-			}
+				const uint16_t x = ((sx - scaled_x_start) * scale) >> 7;
 
-			const uint16_t x = ((sx - scaled_x_start) * scale) >> 7;
+				// one clock per fetched 32 bits
+				if (!(x & 3)) {
+					sprite_budget--;
+					if (sprite_budget == 0)
+						return;
+				}
 
-			// one clock per fetched 32 bits
-			if (!(x & 3)) {
+				// one clock per rendered pixel
 				sprite_budget--;
 				if (sprite_budget == 0)
-					break;
-			}
-
-			// one clock per rendered pixel
-			sprite_budget--;
-			if (sprite_budget == 0)
-				break;
+					return;
 
-			const uint8_t col_index = unpacked_sprite_line[hflip ? width - x - 1 : x];
+				const uint8_t col_index = unpacked_sprite_line[hflip ? width - x - 1 : x];
 
-			// palette offset
-			if (col_index > 0) {
-				sprite_line_collisions |= sprite_line_mask[sx] & props->sprite_collision_mask;
-				sprite_line_mask[sx] |= props->sprite_collision_mask;
+				// palette offset
+				if (col_index > 0) {
+					sprite_line_collisions |= sprite_line_mask[sx] & props->sprite_collision_mask;
+					sprite_line_mask[sx] |= props->sprite_collision_mask;
 
-				if (props->sprite_zdepth > sprite_line_z[sx]) {
-					sprite_line_col[sx] = col_index + props->palette_offset;
-					sprite_line_z[sx]   = props->sprite_zdepth;
+					if (props->sprite_zdepth > sprite_line_z[sx]) {
+						sprite_line_col[sx] = col_index + props->palette_offset;
+						sprite_line_z[sx]   = props->sprite_zdepth;
+					}
 				}
 			}
 		}
 	}
 }
 
+// Without horizontal scaling, screen pixels map 1:1 onto the layer, so each tile row can be expanded whole.
+template <uint8_t layer>
+static void render_layer_line_text_unscaled(const render_source &src, const struct vera_video_layer_properties *props, const uint8_t *tile_bytes, uint32_t y_add)
+{
+	uint8_t *const line = layer_line[layer];
+	uint8_t        row_bytes[2];
+	uint8_t        row[16];
+
+	int eff_x = calc_layer_eff_x(props, 0);
+	for (int i = 0; i < SCREEN_WIDTH;) {
+		const uint32_t map_addr   = calc_layer_map_offset_base2(props, eff_x);
+		const uint8_t  tile_index = tile_bytes[map_addr];
+		const uint8_t  byte1      = tile_bytes[map_addr + 1];
+		const uint8_t  fg_color   = props->text_mode_256c ? byte1 : (byte1 & 15);
+		const uint8_t  bg_color   = props->text_mode_256c ? 0 : (byte1 >> 4);
+		const uint32_t tile_start = tile_index << props->tile_size_log2;
+
+		render_read_range(src, row_bytes, props->tile_base + tile_start + y_add, props->tilew >> 3);
+		expand_1bpp_data(row, row_bytes, props->tilew);
+		for (int x = 0; x < props->tilew; ++x) {
+			row[x] = row[x] ? fg_color : bg_color;
+		}
+
+		const int xx    = eff_x & props->tilew_max;
+		const int count = std::min(props->tilew - xx, SCREEN_WIDTH - i);
+		memcpy(line + i, row + xx, count);
+		i += count;
+		eff_x = (eff_x + count) & props->layerw_max;
+	}
+}
+
 template<uint8_t layer>
-static void render_layer_line_text(uint16_t y)
+static void render_layer_line_text(const render_source &src, uint16_t y)
 {
-	const struct vera_video_layer_properties *props = &layer_properties[layer];
+	const struct vera_video_layer_properties *props = &src.layer_properties[layer];
 
 	const uint8_t max_pixels_per_byte = 7; // (8 >> props->color_depth) - 1; // Don't need this calculation, because props->color_depth will always be 0.
 	const int     eff_y               = calc_layer_eff_y(props, y);
@@ -576,7 +1196,12 @@ static void render_layer_line_text(uint16_t y)
 	const uint32_t y_add = (yy << props->tilew_log2) >> 3;
 
 	uint8_t tile_bytes[512]; // max 256 tiles, 2 bytes each.
-	vera_video_space_read_range(tile_bytes, props->map_base + ((eff_y >> props->tileh_log2) << (props->mapw_log2 + 1)), 2 << props->mapw_log2);
+	render_read_range(src, tile_bytes, props->map_base + ((eff_y >> props->tileh_log2) << (props->mapw_log2 + 1)), 2 << props->mapw_log2);
+
+	if (src.composer[1] == 128) {
+		render_layer_line_text_unscaled<layer>(src, props, tile_bytes, y_add);
+		return;
+	}
 
 	uint32_t tile_start;
 
@@ -610,11 +1235,11 @@ static void render_layer_line_text(uint16_t y)
 		const uint16_t x_add       = xx >> 3;
 		const uint32_t tile_offset = tile_start + y_add + x_add;
 
-		s = vera_video_space_read(props->tile_base + tile_offset);
+		s = render_read(src, props->tile_base + tile_offset);
 	}
 
 	// Render tile line.
-	const uint32_t scale      = reg_composer[1];
+	const uint32_t scale      = src.composer[1];
 	uint32_t       scaled_x   = 0;
 	int            last_eff_x = calc_layer_eff_x(props, 0);
 
@@ -649,7 +1274,7 @@ static void render_layer_line_text(uint16_t y)
 			const uint16_t x_add       = xx >> 3;
 			const uint32_t tile_offset = tile_start + y_add + x_add;
 
-			s = vera_video_space_read(props->tile_base + tile_offset);
+			s = render_read(src, props->tile_base + tile_offset);
 		}
 
 		// convert tile byte to indexed color
@@ -662,103 +1287,113 @@ static void render_layer_line_text(uint16_t y)
 	}
 }
 
-template <uint8_t layer, uint8_t bpp>
-static void render_layer_line_tile(uint16_t y)
+// Decoded 8bpp pixels for a whole tile, from the cache when the VRAM behind it hasn't changed.
+template <uint8_t bpp>
+static const uint8_t *tile_cache_tile(const render_source &src, tile_cache *tiles, const struct vera_video_layer_properties *props, uint16_t tile_index, bool hflip)
 {
-	struct vera_video_layer_properties *props = &layer_properties[layer];
-
-	const uint8_t  max_pixels_per_byte = (8 >> bpp) - 1;
-	const int      eff_y               = calc_layer_eff_y(props, y);
-	const uint8_t  yy                  = eff_y & props->tileh_max;
-	const uint8_t  yy_flip             = yy ^ props->tileh_max;
-	const uint32_t y_add               = (yy << (props->tilew_log2 + bpp - 3));
-	const uint32_t y_add_flip          = (yy_flip << (props->tilew_log2 + bpp - 3));
-
-	uint8_t tile_bytes[512]; // max 256 tiles, 2 bytes each.
-	vera_video_space_read_range(tile_bytes, props->map_base + ((eff_y >> props->tileh_log2) << (props->mapw_log2 + 1)), 2 << props->mapw_log2);
+	const uint32_t address = props->tile_base + (tile_index << props->tile_size_log2);
+	const uint32_t size    = 1 << props->tile_size_log2;
+	uint8_t *const pixels  = tiles->pixels[hflip] + (tile_index << (props->tilew_log2 + props->tileh_log2));
+	uint64_t      &stamp   = tiles->stamps[hflip][tile_index];
+	if (stamp != 0 && line_cache_range_is_clean(src.cache, address, size, stamp)) {
+		line_cache_mark(src.cache, address);
+		return pixels;
+	}
 
-	uint8_t  palette_offset;
-	bool     vflip;
-	bool     hflip;
-	uint32_t tile_start;
-	uint8_t  s;
+	uint8_t tile_bytes[TILE_CACHE_TILE_SIZE];
+	render_read_range(src, tile_bytes, address, size);
+	expand_bpp_data<bpp>(pixels, tile_bytes, props->tilew << props->tileh_log2);
+	if (hflip) {
+		for (uint8_t *row = pixels; row < pixels + (props->tilew << props->tileh_log2); row += props->tilew) {
+			std::reverse(row, row + props->tilew);
+		}
+	}
+	stamp = src.cache->stamp;
+	return pixels;
+}
 
-	{
-		const int eff_x = calc_layer_eff_x(props, 0);
+template <uint8_t layer, uint8_t bpp>
+static void render_layer_line_tile_unscaled(const render_source &src, const struct vera_video_layer_properties *props, const uint8_t *tile_bytes, uint32_t row_offset, uint32_t row_offset_flip)
+{
+	uint8_t *const    line  = layer_line[layer];
+	tile_cache *const tiles = &src.tiles[layer];
 
-		// extract all information from the map
+	int eff_x = calc_layer_eff_x(props, 0);
+	for (int i = 0; i < SCREEN_WIDTH;) {
 		const uint32_t map_addr = calc_layer_map_offset_base2(props, eff_x);
-
-		const uint8_t byte0 = tile_bytes[map_addr];
-		const uint8_t byte1 = tile_bytes[map_addr + 1];
+		const uint8_t  byte0    = tile_bytes[map_addr];
+		const uint8_t  byte1    = tile_bytes[map_addr + 1];
 
 		// Tile Flipping
-		vflip = (byte1 >> 3) & 1;
-		hflip = (byte1 >> 2) & 1;
+		const bool vflip = (byte1 >> 3) & 1;
+		const bool hflip = (byte1 >> 2) & 1;
 
-		palette_offset = byte1 & 0xf0;
+		const uint16_t       tile_index = byte0 | ((byte1 & 3) << 8);
+		const uint8_t *const row        = tile_cache_tile<bpp>(src, tiles, props, tile_index, hflip) + (vflip ? row_offset_flip : row_offset);
 
-		// offset within tilemap of the current tile
-		const uint16_t tile_index = byte0 | ((byte1 & 3) << 8);
-		tile_start                = tile_index << props->tile_size_log2;
+		const int xx    = eff_x & props->tilew_max;
+		const int count = std::min(props->tilew - xx, SCREEN_WIDTH - i);
+		memcpy(line + i, row + xx, count);
+		apply_palette_offset(line + i, count, byte1 & 0xf0, props->text_mode_256c);
+		i += count;
+		eff_x = (eff_x + count) & props->layerw_max;
+	}
+}
 
-		int xx = eff_x & props->tilew_max;
-		if (hflip) {
-			xx = xx ^ (props->tilew_max);
-		}
+template <uint8_t layer, uint8_t bpp>
+static void render_layer_line_tile(const render_source &src, uint16_t y)
+{
+	const struct vera_video_layer_properties *props = &src.layer_properties[layer];
+	tile_cache *const                         tiles = &src.tiles[layer];
 
-		// additional bytes to reach the correct column of the tile
-		uint16_t x_add       = (xx << bpp) >> 3;
-		uint32_t tile_offset = tile_start + (vflip ? y_add_flip : y_add) + x_add;
+	const int      eff_y           = calc_layer_eff_y(props, y);
+	const uint8_t  yy              = eff_y & props->tileh_max;
+	const uint8_t  yy_flip         = yy ^ props->tileh_max;
+	const uint32_t row_offset      = yy << props->tilew_log2;
+	const uint32_t row_offset_flip = yy_flip << props->tilew_log2;
 
-		s = vera_video_space_read(props->tile_base + tile_offset);
-	}
+	uint8_t tile_bytes[512]; // max 256 tiles, 2 bytes each.
+	render_read_range(src, tile_bytes, props->map_base + ((eff_y >> props->tileh_log2) << (props->mapw_log2 + 1)), 2 << props->mapw_log2);
 
-	// Render tile line.
-	const uint32_t scale      = reg_composer[1];
-	uint32_t       scaled_x   = 0;
-	int            last_eff_x = calc_layer_eff_x(props, 0);
+	tile_cache_set_layout(tiles, props);
 
-	for (int i = 0; i < SCREEN_WIDTH; i++) {
-		const uint16_t x     = scaled_x >> 7;
-		const int      eff_x = calc_layer_eff_x(props, x);
+	if (src.composer[1] == 128) {
+		render_layer_line_tile_unscaled<layer, bpp>(src, props, tile_bytes, row_offset, row_offset_flip);
+		return;
+	}
 
-		if ((eff_x ^ last_eff_x) & ~max_pixels_per_byte) {
-			if ((eff_x ^ last_eff_x) & ~props->tilew_max) {
-				// extract all information from the map
-				const uint32_t map_addr = calc_layer_map_offset_base2(props, eff_x);
+	// Render tile line.
+	const uint32_t scale       = src.composer[1];
+	uint32_t       scaled_x    = 0;
+	int            last_tile_x = -1;
 
-				const uint8_t byte0 = tile_bytes[map_addr];
-				const uint8_t byte1 = tile_bytes[map_addr + 1];
+	uint8_t        palette_offset = 0;
+	const uint8_t *row            = nullptr;
 
-				// Tile Flipping
-				vflip = (byte1 >> 3) & 1;
-				hflip = (byte1 >> 2) & 1;
+	for (int i = 0; i < SCREEN_WIDTH; i++) {
+		const uint16_t x      = scaled_x >> 7;
+		const int      eff_x  = calc_layer_eff_x(props, x);
+		const int      tile_x = eff_x >> props->tilew_log2;
 
-				palette_offset = byte1 & 0xf0;
+		if (tile_x != last_tile_x) {
+			// extract all information from the map
+			const uint32_t map_addr = calc_layer_map_offset_base2(props, eff_x);
 
-				// offset within tilemap of the current tile
-				const uint16_t tile_index = byte0 | ((byte1 & 3) << 8);
-				tile_start                = tile_index << props->tile_size_log2;
-			}
+			const uint8_t byte0 = tile_bytes[map_addr];
+			const uint8_t byte1 = tile_bytes[map_addr + 1];
 
-			int xx = eff_x & props->tilew_max;
-			if (hflip) {
-				xx = xx ^ (props->tilew_max);
-			}
+			// Tile Flipping
+			const bool vflip = (byte1 >> 3) & 1;
+			const bool hflip = (byte1 >> 2) & 1;
 
-			// additional bytes to reach the correct column of the tile
-			const uint16_t x_add       = (xx << bpp) >> 3;
-			const uint32_t tile_offset = tile_start + (vflip ? y_add_flip : y_add) + x_add;
+			palette_offset = byte1 & 0xf0;
 
-			s = vera_video_space_read(props->tile_base + tile_offset);
+			const uint16_t tile_index = byte0 | ((byte1 & 3) << 8);
+			row                       = tile_cache_tile<bpp>(src, tiles, props, tile_index, hflip) + (vflip ? row_offset_flip : row_offset);
+			last_tile_x               = tile_x;
 		}
 
-		uint8_t color_shift = hflip ?
-			(eff_x & max_pixels_per_byte) << bpp :
-			props->first_color_pos - ((eff_x & max_pixels_per_byte) << bpp);
-		// convert tile byte to indexed color
-		uint8_t col_index = (s >> color_shift) & props->color_mask;
+		uint8_t col_index = row[eff_x & props->tilew_max];
 
 		// Apply Palette Offset
 		if (col_index > 0 && col_index < 16) {
@@ -770,56 +1405,84 @@ static void render_layer_line_tile(uint16_t y)
 		layer_line[layer][i] = col_index;
 
 		scaled_x += scale;
-		last_eff_x = eff_x;
 	}
 }
 
 template <uint8_t layer>
-static void render_layer_line_tile(uint16_t y)
+static void render_layer_line_tile(const render_source &src, uint16_t y)
+{
+	switch (src.layer_properties[layer].color_depth) {
+	case 0x0: render_layer_line_tile<layer, 0>(src, y); break;
+	case 0x1: render_layer_line_tile<layer, 1>(src, y); break;
+	case 0x2: render_layer_line_tile<layer, 2>(src, y); break;
+	case 0x3: render_layer_line_tile<layer, 3>(src, y); break;
+	}
+}
+
+// Decodes the first width pixels of a bitmap row, with the layer's palette offset applied.
+template <uint8_t layer>
+static void expand_bitmap_row(const render_source &src, const struct vera_video_layer_properties *props, uint8_t *dst, uint32_t y_add, uint16_t width)
 {
-	switch (layer_properties[layer].color_depth) {
-	case 0x0: render_layer_line_tile<layer, 0>(y); break;
-	case 0x1: render_layer_line_tile<layer, 1>(y); break;
-	case 0x2: render_layer_line_tile<layer, 2>(y); break;
-	case 0x3: render_layer_line_tile<layer, 3>(y); break;
+	const uint32_t address = props->tile_base + y_add;
+	if (props->color_depth == 3) {
+		// 8bpp is already one byte per pixel.
+		render_read_range(src, dst, address, width);
+	} else {
+		uint8_t row_bytes[SCREEN_WIDTH];
+		render_read_range(src, row_bytes, address, (width * props->bits_per_pixel) >> 3);
+		switch (props->color_depth) {
+			case 0: expand_bpp_data<0>(dst, row_bytes, width); break;
+			case 1: expand_bpp_data<1>(dst, row_bytes, width); break;
+			case 2: expand_bpp_data<2>(dst, row_bytes, width); break;
+		}
 	}
+	apply_palette_offset(dst, width, (src.layer[layer][4] & 0xf) << 4, props->text_mode_256c);
 }
 
 template<uint8_t layer>
-static void render_layer_line_bitmap(uint16_t y)
+static void render_layer_line_bitmap(const render_source &src, uint16_t y)
 {
-	struct vera_video_layer_properties *props = &layer_properties[layer];
+	const struct vera_video_layer_properties *props = &src.layer_properties[layer];
+	uint8_t *const                            line  = layer_line[layer];
 
 	int yy = y % props->tileh;
 	// additional bytes to reach the correct line of the tile
 	uint32_t y_add = (yy * props->tilew * props->bits_per_pixel) >> 3;
 
-	// Render tile line.
-	const uint32_t scale    = reg_composer[1];
-	uint32_t       scaled_x = 0;
-	for (int i = 0; i < SCREEN_WIDTH; i++) {
-		const uint16_t x  = scaled_x >> 7;
-		int            xx = x % props->tilew;
+	// Bitmaps don't scroll, so every scale just samples the one row from its start.
+	const uint32_t scale = src.composer[1];
+	if (scale == 128) {
+		expand_bitmap_row<layer>(src, props, line, y_add, props->tilew);
 
-		// extract all information from the map
-		uint8_t palette_offset = reg_layer[layer][4] & 0xf;
+		// A 320 pixel bitmap repeats across the rest of the line.
+		for (int x = props->tilew; x < SCREEN_WIDTH; x += props->tilew) {
+			memcpy(line + x, line, std::min((int)props->tilew, SCREEN_WIDTH - x));
+		}
+		return;
+	}
 
-		// additional bytes to reach the correct column of the tile
-		uint16_t x_add       = (xx * props->bits_per_pixel) >> 3;
-		uint32_t tile_offset = y_add + x_add;
-		uint8_t  s           = vera_video_space_read(props->tile_base + tile_offset);
+	// Only decode as much of the row as the scale will reach, in whole bytes of 1bpp.
+	const uint32_t last_x = ((SCREEN_WIDTH - 1) * scale) >> 7;
+	const uint16_t width  = (uint16_t)std::min((last_x + 8) & ~7u, (uint32_t)props->tilew);
 
-		// convert tile byte to indexed color
-		uint8_t col_index = (s >> (props->first_color_pos - ((xx & props->color_fields_max) << props->color_depth))) & props->color_mask;
+	uint8_t row[SCREEN_WIDTH];
+	expand_bitmap_row<layer>(src, props, row, y_add, width);
 
-		// Apply Palette Offset
-		if (col_index > 0 && col_index < 16) {
-			col_index += palette_offset << 4;
-			if (props->text_mode_256c) {
-				col_index |= 0x80;
-			}
+	if (scale == 64) {
+		double_pixels(line, row, SCREEN_WIDTH / 2);
+		return;
+	}
+
+	// Render tile line. Steps are under two pixels, so one subtraction is enough to wrap.
+	uint32_t scaled_x = 0;
+	uint16_t wrap_x   = 0;
+	for (int i = 0; i < SCREEN_WIDTH; i++) {
+		uint16_t xx = (scaled_x >> 7) - wrap_x;
+		if (xx >= props->tilew) {
+			xx -= props->tilew;
+			wrap_x += props->tilew;
 		}
-		layer_line[layer][i] = col_index;
+		line[i] = row[xx];
 
 		scaled_x += scale;
 	}
@@ -845,64 +1508,63 @@ static uint8_t calculate_line_col_index(uint8_t spr_zindex, uint8_t spr_col_inde
 	return col_index;
 }
 
-static void render_line(uint16_t y)
+static void render_line_direct(const render_source &src, uint16_t y)
 {
-	if (y >= SCREEN_HEIGHT) {
-		return;
-	}
-
-	const uint8_t out_mode = reg_composer[0] & 3;
+	const uint8_t out_mode = src.composer[0] & 3;
 
-	const uint8_t  border_color = reg_composer[3];
-	const uint16_t hstart       = reg_composer[4] << 2;
-	const uint16_t hstop        = reg_composer[5] << 2;
-	const uint16_t vstart       = reg_composer[6] << 1;
-	const uint16_t vstop        = reg_composer[7] << 1;
+	const uint8_t  border_color = src.composer[3];
+	const uint16_t hstart       = src.composer[4] << 2;
+	const uint16_t hstop        = src.composer[5] << 2;
+	const uint16_t vstart       = src.composer[6] << 1;
+	const uint16_t vstop        = src.composer[7] << 1;
 
-	const int eff_y = (reg_composer[2] * (y - vstart)) >> 7;
+	const int eff_y = (src.composer[2] * (y - vstart)) >> 7;
 
-	const uint8_t dc_video = reg_composer[0];
+	const uint8_t dc_video = src.composer[0];
 
 	const bool layer0_was_enabled = layer_line_enable[0];
 	const bool layer1_was_enabled = layer_line_enable[1];
 	const bool sprite_was_enabled = sprite_line_enable;
 
-	layer_line_enable[0] = dc_video & 0x10;
-	layer_line_enable[1] = dc_video & 0x20;
-	sprite_line_enable   = dc_video & 0x40;
+	sprite_line_enable = dc_video & 0x40;
 
 	if (sprite_line_enable) {
-		render_sprite_line(eff_y);
+		render_sprite_line(src, eff_y);
 	} else if (sprite_was_enabled) {
 		memset(sprite_line_z, 0, SCREEN_WIDTH);
 		memset(sprite_line_col, 0, SCREEN_WIDTH);
 	}
 
-	if (vera_video_is_cheat_frame()) {
+	if (src.cheat_frame) {
 		// sprites were needed for the collision IRQ, but we can skip
 		// everything else if we're cheating and not actually updating.
 		return;
 	}
 
+	// Only latch the layer enables once the layer lines are actually updated,
+	// or a layer turned off during a cheat frame would never get cleared.
+	layer_line_enable[0] = dc_video & 0x10;
+	layer_line_enable[1] = dc_video & 0x20;
+
 	if (layer_line_enable[0]) {
-		if (layer_properties[0].text_mode) {
-			render_layer_line_text<0>(eff_y);
-		} else if (layer_properties[0].bitmap_mode) {
-			render_layer_line_bitmap<0>(eff_y);
+		if (src.layer_properties[0].text_mode) {
+			render_layer_line_text<0>(src, eff_y);
+		} else if (src.layer_properties[0].bitmap_mode) {
+			render_layer_line_bitmap<0>(src, eff_y);
 		} else {
-			render_layer_line_tile<0>(eff_y);
+			render_layer_line_tile<0>(src, eff_y);
 		}
 	} else if (layer0_was_enabled) {
 		memset(layer_line[0], 0, SCREEN_WIDTH);
 	}
 
 	if (layer_line_enable[1]) {
-		if (layer_properties[1].text_mode) {
-			render_layer_line_text<1>(eff_y);
-		} else if (layer_properties[1].bitmap_mode) {
-			render_layer_line_bitmap<1>(eff_y);
+		if (src.layer_properties[1].text_mode) {
+			render_layer_line_text<1>(src, eff_y);
+		} else if (src.layer_properties[1].bitmap_mode) {
+			render_layer_line_bitmap<1>(src, eff_y);
 		} else {
-			render_layer_line_tile<1>(eff_y);
+			render_layer_line_tile<1>(src, eff_y);
 		}
 	} else if (layer1_was_enabled) {
 		memset(layer_line[1], 0, SCREEN_WIDTH);
@@ -910,8 +1572,8 @@ static void render_line(uint16_t y)
 
 	uint8_t col_line[SCREEN_WIDTH];
 
-	if (video_palette.dirty) {
-		refresh_palette();
+	if (src.video_palette->dirty) {
+		refresh_palette(src.video_palette, src.palette, src.composer[0]);
 	}
 
 	// If video output is enabled, calculate color indices for line.
@@ -924,7 +1586,8 @@ static void render_line(uint16_t y)
 			memset(col_line, border_fill, SCREEN_WIDTH);
 		} else {
 			const uint16_t xstart = hstart < 640 ? hstart : 640;
-			const uint16_t xstop  = hstop < 640 ? hstop : 640;
+			// HSTOP before HSTART leaves the whole line as border.
+			const uint16_t xstop  = std::max(xstart, hstop < 640 ? hstop : (uint16_t)640);
 
 			for (uint16_t x = 0; x < xstart; ++x) {
 				col_line[x] = border_color;
@@ -939,36 +1602,417 @@ static void render_line(uint16_t y)
 		}
 	}
 
-	// Look up all color indices.
-	uint32_t *const framebuffer4_begin = ((uint32_t *)framebuffer) + (y * SCREEN_WIDTH);
-	{
-		uint32_t *framebuffer4 = framebuffer4_begin;
-		for (uint16_t x = 0; x < SCREEN_WIDTH; x++) {
-			*framebuffer4++ = video_palette.entries[col_line[x]];
+	if (Indexed_output) {
+		if (src.video_palette != Palette_slot_source || src.video_palette->version != Palette_slot_version) {
+			palette_slot_store(src.cache, src.video_palette);
 		}
+		memcpy(Indexed_pixels + y * SCREEN_WIDTH, col_line, SCREEN_WIDTH);
+		uint8_t *const line = Indexed_lines + y * 4;
+		line[0]             = Palette_slot & 0xff;
+		line[1]             = Palette_slot >> 8;
+		line[2]             = safety_frame_mode(src.safety_frame, y);
+		Framebuffer_stale   = true;
+		return;
 	}
 
+	// Look up all color indices.
+	uint32_t *const framebuffer4 = ((uint32_t *)framebuffer) + (y * SCREEN_WIDTH);
+	palette_lookup(framebuffer4, col_line, src.video_palette->entries, SCREEN_WIDTH);
+
 	// NTSC overscan
-	if (!shadow_safety_frame[0] && shadow_safety_frame[out_mode]) {
-		uint32_t *framebuffer4 = framebuffer4_begin;
-		for (uint16_t x = 0; x < SCREEN_WIDTH; x++) {
-			if (x < SCREEN_WIDTH * TITLE_SAFE_X ||
-			    x > SCREEN_WIDTH * (1 - TITLE_SAFE_X) ||
-			    y < SCREEN_HEIGHT * TITLE_SAFE_Y ||
-			    y > SCREEN_HEIGHT * (1 - TITLE_SAFE_Y)) {
-
-				// Divide RGB elements by 4.
-				*framebuffer4 &= 0x00fcfcfc;
-				*framebuffer4 >>= 2;
+	darken_safety_frame(framebuffer4, safety_frame_mode(src.safety_frame, y));
+}
+
+static void render_line(const render_source &src, uint16_t y)
+{
+	if (y >= SCREEN_HEIGHT) {
+		return;
+	}
+
+	line_cache *const cache = src.cache;
+	line_cache_line  &line  = cache->lines[y];
+	++cache->stamp;
+
+	// The interlace field bit doesn't change what gets drawn.
+	uint8_t regs[LINE_CACHE_REGS];
+	regs[0] = src.composer[0] & 0x7f;
+	memcpy(regs + 1, src.composer + 1, 7);
+	memcpy(regs + 8, src.layer[0], 7);
+	memcpy(regs + 15, src.layer[1], 7);
+	regs[22] = src.safety_frame;
+
+	if (line.valid && memcmp(line.regs, regs, sizeof(regs)) == 0 && line_cache_is_clean(cache, line)) {
+		sprite_line_collisions |= line.collisions;
+		Lines_reused.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	Lines_rendered.fetch_add(1, std::memory_order_relaxed);
+
+	memset(cache->reading, 0, sizeof(cache->reading));
+	line_cache_mark_range(cache, ADDR_PALETTE_START, ADDR_PALETTE_END - ADDR_PALETTE_START);
+	if (src.composer[0] & 0x40) {
+		line_cache_mark_range(cache, ADDR_SPRDATA_START, ADDR_SPRDATA_END - ADDR_SPRDATA_START);
+	}
+
+	const uint8_t old_collisions = sprite_line_collisions;
+	sprite_line_collisions       = 0;
+	render_line_direct(src, y);
+	line.collisions        = sprite_line_collisions;
+	sprite_line_collisions = old_collisions | line.collisions;
+
+	memcpy(line.read_pages, cache->reading, sizeof(line.read_pages));
+	memcpy(line.regs, regs, sizeof(regs));
+	line.stamp = cache->stamp;
+	// Cheat frames skip the framebuffer, so there's nothing to reuse.
+	line.valid = !src.cheat_frame;
+}
+
+void vera_video_take_dirty_vram_pages(std::vector<uint32_t> &pages)
+{
+	for (uint32_t page = 0; page < LINE_CACHE_PAGES; ++page) {
+		if (Live_cache.page_stamps[page] >= Dirty_vram_stamp) {
+			pages.push_back(page << LINE_CACHE_PAGE_SHIFT);
+		}
+	}
+	// Writes from here on get a stamp no earlier page has.
+	Dirty_vram_stamp = ++Live_cache.stamp;
+}
+
+void vera_video_get_line_cache_stats(uint64_t *reused, uint64_t *rendered)
+{
+	*reused   = Lines_reused.load(std::memory_order_relaxed);
+	*rendered = Lines_rendered.load(std::memory_order_relaxed);
+}
+
+//
+// Render thread
+//
+// With the render thread on, the CPU thread only queues each line, along with the composer
+// and layer registers as they stood at that point. VRAM writes go into a log, and the render
+// thread replays the log into its own copy of VRAM up to where each line was queued, so
+// raster effects come out the same as rendering synchronously. The CPU thread only waits at
+// VSYNC, for the sprite collisions, and when something needs the finished frame.
+//
+
+#define RENDER_JOB_COUNT 1024
+#define RENDER_LOG_COUNT (64 * 1024)
+
+// Log entries flagged with this only update the palette, for vera_video_set_palette().
+#define RENDER_LOG_PALETTE_ONLY 0x80000000
+
+struct render_job {
+	uint64_t log_end;
+	uint16_t y;
+	bool     cheat_frame;
+	bool     safety_frame;
+	uint8_t  composer[8];
+	uint8_t  layer[2][7];
+};
+
+struct render_log_entry {
+	uint32_t address;
+	uint8_t  value;
+};
+
+struct render_mirror {
+	uint8_t                      video_ram[0x20000];
+	uint8_t                      palette[256 * 2];
+	uint8_t                      sprite_data[128][8];
+	uint8_t                      composer[8];
+	uint8_t                      layer[2][7];
+	vera_video_layer_properties  layer_properties[2];
+	vera_video_sprite_properties sprite_properties[128];
+	video_palette_props          video_palette;
+	line_cache                   cache;
+	sprite_cache                 sprites;
+	tile_cache                   tiles[2];
+};
+
+static bool           Render_thread_enabled = false;
+static std::thread    Render_thread;
+static render_mirror *Mirror = nullptr;
+
+static render_job       *Render_jobs = nullptr;
+static render_log_entry *Render_log  = nullptr;
+
+static std::atomic<uint64_t> Job_write;
+static std::atomic<uint64_t> Job_read;
+static std::atomic<uint64_t> Log_write;
+static std::atomic<uint64_t> Log_read;
+
+static std::mutex              Render_mutex;
+static std::condition_variable Render_wake;
+static std::condition_variable Render_done;
+static bool                    Render_quit = false;
+
+static render_source live_source()
+{
+	const uint8_t out_mode = reg_composer[0] & 3;
+
+	render_source src;
+	src.video_ram         = video_ram;
+	src.palette           = palette;
+	src.composer          = reg_composer;
+	src.layer             = reg_layer;
+	src.layer_properties  = layer_properties;
+	src.sprite_properties = sprite_properties;
+	src.video_palette     = &video_palette;
+	src.cache             = &Live_cache;
+	src.sprites           = &Live_sprites;
+	src.tiles             = Live_tiles;
+	src.cheat_frame       = vera_video_is_cheat_frame();
+	src.safety_frame      = !shadow_safety_frame[0] && shadow_safety_frame[out_mode];
+	return src;
+}
+
+static void mirror_write(uint32_t address, uint8_t value)
+{
+	if (address & RENDER_LOG_PALETTE_ONLY) {
+		Mirror->palette[address & 0x1ff] = value;
+		Mirror->video_palette.dirty      = true;
+		line_cache_write(&Mirror->cache, ADDR_PALETTE_START);
+		return;
+	}
+
+	Mirror->video_ram[address] = value;
+	line_cache_write(&Mirror->cache, address);
+	if (address >= ADDR_PALETTE_START && address < ADDR_PALETTE_END) {
+		Mirror->palette[address & 0x1ff] = value;
+		Mirror->video_palette.dirty      = true;
+	} else if (address >= ADDR_SPRDATA_START && address < ADDR_SPRDATA_END) {
+		const uint16_t sprite                      = (address >> 3) & 0x7f;
+		Mirror->sprite_data[sprite][address & 0x7] = value;
+		refresh_sprite_properties(&Mirror->sprite_properties[sprite], &Mirror->sprites, (uint8_t)sprite, Mirror->sprite_data[sprite]);
+	}
+}
+
+static void mirror_apply_log(uint64_t end)
+{
+	uint64_t pos = Log_read.load(std::memory_order_relaxed);
+	for (; pos != end; ++pos) {
+		const render_log_entry &entry = Render_log[pos % RENDER_LOG_COUNT];
+		mirror_write(entry.address, entry.value);
+	}
+	Log_read.store(pos, std::memory_order_release);
+}
+
+static void mirror_render(const render_job &job)
+{
+	if (job.composer[0] != Mirror->composer[0]) {
+		Mirror->video_palette.dirty = true;
+	}
+	memcpy(Mirror->composer, job.composer, sizeof(Mirror->composer));
+	for (uint8_t layer = 0; layer < 2; ++layer) {
+		if (memcmp(Mirror->layer[layer], job.layer[layer], sizeof(Mirror->layer[layer])) != 0) {
+			memcpy(Mirror->layer[layer], job.layer[layer], sizeof(Mirror->layer[layer]));
+			refresh_layer_properties(&Mirror->layer_properties[layer], Mirror->layer[layer]);
+		}
+	}
+
+	render_source src;
+	src.video_ram         = Mirror->video_ram;
+	src.palette           = Mirror->palette;
+	src.composer          = Mirror->composer;
+	src.layer             = Mirror->layer;
+	src.layer_properties  = Mirror->layer_properties;
+	src.sprite_properties = Mirror->sprite_properties;
+	src.video_palette     = &Mirror->video_palette;
+	src.cache             = &Mirror->cache;
+	src.sprites           = &Mirror->sprites;
+	src.tiles             = Mirror->tiles;
+	src.cheat_frame       = job.cheat_frame;
+	src.safety_frame      = job.safety_frame;
+	render_line(src, job.y);
+}
+
+static void render_thread_main()
+{
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(Render_mutex);
+			Render_wake.wait(lock, [] {
+				return Render_quit || Job_read.load() != Job_write.load() || Log_read.load() != Log_write.load();
+			});
+			if (Render_quit) {
+				return;
 			}
-			framebuffer4++;
 		}
+
+		for (;;) {
+			// Read the log position first: any job queued after this point can only end later in the log.
+			const uint64_t log_end = Log_write.load(std::memory_order_acquire);
+			const uint64_t job_pos = Job_read.load(std::memory_order_relaxed);
+			if (job_pos != Job_write.load(std::memory_order_acquire)) {
+				const render_job &job = Render_jobs[job_pos % RENDER_JOB_COUNT];
+				mirror_apply_log(job.log_end);
+				mirror_render(job);
+				Job_read.store(job_pos + 1, std::memory_order_release);
+			} else if (Log_read.load(std::memory_order_relaxed) != log_end) {
+				// Nothing queued to render, so every logged write is in the past.
+				mirror_apply_log(log_end);
+			} else {
+				break;
+			}
+			{
+				std::lock_guard<std::mutex> lock(Render_mutex);
+			}
+			Render_done.notify_all();
+		}
+	}
+}
+
+static void render_thread_wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(Render_mutex);
+	}
+	Render_wake.notify_one();
+}
+
+// Wait until the render thread has caught up with everything queued so far.
+static void render_thread_wait()
+{
+	if (!Render_thread_enabled) {
+		return;
+	}
+	if (Job_read.load() == Job_write.load() && Log_read.load() == Log_write.load()) {
+		return;
+	}
+
+	profiler_scope scope(profiler_section::render);
+
+	render_thread_wake();
+	std::unique_lock<std::mutex> lock(Render_mutex);
+	Render_done.wait(lock, [] {
+		return Job_read.load() == Job_write.load() && Log_read.load() == Log_write.load();
+	});
+}
+
+// Bring the render thread's copy up to date after the live state changed without going through the log.
+static void render_thread_resync()
+{
+	if (!Render_thread_enabled) {
+		return;
+	}
+	render_thread_wait();
+
+	memcpy(Mirror->video_ram, video_ram, sizeof(Mirror->video_ram));
+	memcpy(Mirror->palette, palette, sizeof(Mirror->palette));
+	memcpy(Mirror->sprite_data, sprite_data, sizeof(Mirror->sprite_data));
+	memcpy(Mirror->composer, reg_composer, sizeof(Mirror->composer));
+	memcpy(Mirror->layer, reg_layer, sizeof(Mirror->layer));
+	for (uint8_t layer = 0; layer < 2; ++layer) {
+		refresh_layer_properties(&Mirror->layer_properties[layer], Mirror->layer[layer]);
+	}
+	for (uint16_t i = 0; i < NUM_SPRITES; ++i) {
+		refresh_sprite_properties(&Mirror->sprite_properties[i], &Mirror->sprites, (uint8_t)i, Mirror->sprite_data[i]);
+	}
+	refresh_palette(&Mirror->video_palette, Mirror->palette, Mirror->composer[0]);
+	line_cache_invalidate(&Mirror->cache);
+}
+
+static void render_thread_log(uint32_t address, uint8_t value)
+{
+	const uint64_t pos = Log_write.load(std::memory_order_relaxed);
+	if (pos - Log_read.load(std::memory_order_acquire) >= RENDER_LOG_COUNT) {
+		render_thread_wake();
+		std::unique_lock<std::mutex> lock(Render_mutex);
+		Render_done.wait(lock, [pos] { return pos - Log_read.load() < RENDER_LOG_COUNT; });
+	}
+	Render_log[pos % RENDER_LOG_COUNT] = { address, value };
+	Log_write.store(pos + 1, std::memory_order_release);
+}
+
+// Call after each change to video_ram, with the address already wrapped to VRAM.
+static void vram_written(uint32_t address)
+{
+	line_cache_write(&Live_cache, address);
+	if (Render_thread_enabled) {
+		render_thread_log(address, video_ram[address]);
+	}
+}
+
+static void render_line(uint16_t y)
+{
+	if (y >= SCREEN_HEIGHT) {
+		return;
+	}
+
+	if (!Render_thread_enabled) {
+		profiler_scope scope(profiler_section::render);
+		render_line(live_source(), y);
+		return;
+	}
+
+	const uint64_t pos = Job_write.load(std::memory_order_relaxed);
+	if (pos - Job_read.load(std::memory_order_acquire) >= RENDER_JOB_COUNT) {
+		render_thread_wait();
+	}
+
+	render_job &job  = Render_jobs[pos % RENDER_JOB_COUNT];
+	job.log_end      = Log_write.load(std::memory_order_relaxed);
+	job.y            = y;
+	job.cheat_frame  = vera_video_is_cheat_frame();
+	job.safety_frame = !shadow_safety_frame[0] && shadow_safety_frame[reg_composer[0] & 3];
+	memcpy(job.composer, reg_composer, sizeof(job.composer));
+	memcpy(job.layer, reg_layer, sizeof(job.layer));
+	Job_write.store(pos + 1, std::memory_order_release);
+
+	render_thread_wake();
+}
+
+void vera_video_set_render_thread(bool enable)
+{
+	if (enable == Render_thread_enabled) {
+		return;
+	}
+
+	if (enable) {
+		Mirror      = new render_mirror();
+		Render_jobs = new render_job[RENDER_JOB_COUNT];
+		Render_log  = new render_log_entry[RENDER_LOG_COUNT];
+		Job_write   = 0;
+		Job_read    = 0;
+		Log_write   = 0;
+		Log_read    = 0;
+		Render_quit = false;
+
+		Render_thread_enabled = true;
+		Palette_slot_source   = nullptr;
+		render_thread_resync();
+		Render_thread = std::thread(render_thread_main);
+	} else {
+		render_thread_wait();
+		{
+			std::lock_guard<std::mutex> lock(Render_mutex);
+			Render_quit = true;
+		}
+		Render_wake.notify_one();
+		Render_thread.join();
+		Render_thread_enabled = false;
+
+		// The render thread drew the framebuffer since the live cache last saw it.
+		line_cache_invalidate(&Live_cache);
+		Palette_slot_source = nullptr;
+
+		delete Mirror;
+		delete[] Render_jobs;
+		delete[] Render_log;
+		Mirror      = nullptr;
+		Render_jobs = nullptr;
+		Render_log  = nullptr;
 	}
 }
 
+bool vera_video_get_render_thread()
+{
+	return Render_thread_enabled;
+}
+
 static void update_isr_and_coll(uint16_t y, uint16_t compare)
 {
 	if (y == SCREEN_HEIGHT) {
+		render_thread_wait();
 		if (ien & 4) {
 			if (sprite_line_collisions != 0) {
 				isr |= 4;
@@ -983,14 +2027,17 @@ static void update_isr_and_coll(uint16_t y, uint16_t compare)
 	}
 }
 
-bool vera_video_step(float mhz, float steps)
+bool vera_video_step(uint32_t mhz, uint32_t clocks)
 {
-	uint16_t y         = 0;
-	bool     ntsc_mode = reg_composer[0] & 2;
-	bool     new_frame = false;
-	vga_scan_pos_x += PIXEL_FREQ * steps / mhz;
-	if (vga_scan_pos_x > VGA_SCAN_WIDTH) {
-		vga_scan_pos_x -= VGA_SCAN_WIDTH;
+	uint16_t       y         = 0;
+	bool           ntsc_mode = reg_composer[0] & 2;
+	bool           new_frame = false;
+	const uint32_t ticks     = clocks * (SCAN_TICK_FREQ / mhz);
+
+	// A step may cover several lines, as long as it stops at each line vera_video_clocks_until_next_event() asks for.
+	vga_scan_pos_x += ticks;
+	while (vga_scan_pos_x >= VGA_LINE_TICKS) {
+		vga_scan_pos_x -= VGA_LINE_TICKS;
 		if (!ntsc_mode) {
 			render_line(vga_scan_pos_y - VGA_Y_OFFSET);
 		}
@@ -1006,9 +2053,9 @@ bool vera_video_step(float mhz, float steps)
 			update_isr_and_coll(vga_scan_pos_y - VGA_Y_OFFSET, irq_line);
 		}
 	}
-	ntsc_half_cnt += PIXEL_FREQ * steps / mhz;
-	if (ntsc_half_cnt > NTSC_HALF_SCAN_WIDTH) {
-		ntsc_half_cnt -= NTSC_HALF_SCAN_WIDTH;
+	ntsc_half_cnt += ticks;
+	while (ntsc_half_cnt >= NTSC_HALF_LINE_TICKS) {
+		ntsc_half_cnt -= NTSC_HALF_LINE_TICKS;
 		if (ntsc_mode) {
 			if (ntsc_scan_pos_y < SCAN_HEIGHT) {
 				y = ntsc_scan_pos_y - NTSC_Y_OFFSET_LOW;
@@ -1051,8 +2098,38 @@ bool vera_video_step(float mhz, float steps)
 	return new_frame;
 }
 
+// Number of line boundaries until the VGA scan position next becomes target_y (1 to SCAN_HEIGHT).
+static uint32_t vga_lines_until(uint16_t target_y)
+{
+	return (target_y + SCAN_HEIGHT - vga_scan_pos_y - 1) % SCAN_HEIGHT + 1;
+}
+
+uint32_t vera_video_clocks_until_next_event(uint32_t mhz)
+{
+	const uint32_t ticks_per_clock = SCAN_TICK_FREQ / mhz;
+
+	uint32_t remaining;
+	if (reg_composer[0] & 2) {
+		// NTSC steps one half-line at a time.
+		remaining = NTSC_HALF_LINE_TICKS - ntsc_half_cnt;
+	} else {
+		// Everything else a line boundary does, the CPU can only observe through a VERA access,
+		// which brings VERA up to date first. So only the end of the frame, VSYNC and the line
+		// IRQ need to land on time, and every line in between can be rendered in one batch.
+		uint32_t lines = std::min(vga_lines_until(0), vga_lines_until(SCREEN_HEIGHT + VGA_Y_OFFSET));
+		if ((ien & 2) && irq_line < SCREEN_HEIGHT) {
+			lines = std::min(lines, vga_lines_until(irq_line + VGA_Y_OFFSET));
+		}
+		remaining = lines * VGA_LINE_TICKS - vga_scan_pos_x;
+	}
+	return (remaining + ticks_per_clock - 1) / ticks_per_clock;
+}
+
 void vera_video_force_redraw_screen()
 {
+	render_thread_wait();
+	line_cache_invalidate(&Live_cache);
+
 	const uint8_t old_sprite_line_collisions = sprite_line_collisions;
 
 	for (int y = 0; y < SCREEN_HEIGHT; ++y) {
@@ -1081,6 +2158,78 @@ void vera_video_save(x16file *f)
 	x16write_bankdump(f, "VERA SPRITES", sprite_data, 0, sizeof(sprite_data[0]), sizeof(sprite_data) / sizeof(sprite_data[0]), 0, 0);
 }
 
+void vera_video_save_restore(savestate &state)
+{
+	render_thread_wait();
+
+	if (!state.memory_excluded()) {
+		state.save_restore(video_ram);
+	}
+	state.save_restore(palette);
+	state.save_restore(sprite_data);
+
+	state.save_restore(io_addr);
+	state.save_restore(io_rddata);
+	state.save_restore(io_inc);
+	state.save_restore(io_addrsel);
+	state.save_restore(io_dcsel);
+	state.save_restore(ien);
+	state.save_restore(isr);
+	state.save_restore(irq_line);
+	state.save_restore(reg_layer);
+	state.save_restore(reg_composer);
+
+	state.save_restore(sprite_line_collisions);
+	state.save_restore(vga_scan_pos_x);
+	state.save_restore(vga_scan_pos_y);
+	state.save_restore(ntsc_half_cnt);
+	state.save_restore(ntsc_scan_pos_y);
+	state.save_restore(frame_count);
+
+	state.save_restore(fx_addr1_mode);
+	state.save_restore(fx_x_pixel_increment);
+	state.save_restore(fx_y_pixel_increment);
+	state.save_restore(fx_x_pixel_position);
+	state.save_restore(fx_y_pixel_position);
+	state.save_restore(fx_poly_fill_length);
+	state.save_restore(fx_affine_tile_base);
+	state.save_restore(fx_affine_map_base);
+	state.save_restore(fx_affine_map_size);
+	state.save_restore(fx_4bit_mode);
+	state.save_restore(fx_16bit_hop);
+	state.save_restore(fx_cache_byte_cycling);
+	state.save_restore(fx_cache_fill);
+	state.save_restore(fx_cache_write);
+	state.save_restore(fx_trans_writes);
+	state.save_restore(fx_2bit_poly);
+	state.save_restore(fx_2bit_poking);
+	state.save_restore(fx_cache_increment_mode);
+	state.save_restore(fx_cache_nibble_index);
+	state.save_restore(fx_cache_byte_index);
+	state.save_restore(fx_multiplier);
+	state.save_restore(fx_subtract);
+	state.save_restore(fx_affine_clip);
+	state.save_restore(fx_16bit_hop_align);
+	state.save_restore(fx_nibble_bit);
+	state.save_restore(fx_nibble_incr);
+	state.save_restore(fx_cache);
+	state.save_restore(fx_mult_accumulator);
+
+	psg_save_restore(state);
+	pcm_save_restore(state);
+
+	if (!state.saving()) {
+		refresh_layer_properties(0);
+		refresh_layer_properties(1);
+		for (uint16_t i = 0; i < 128; ++i) {
+			refresh_sprite_properties(i);
+		}
+		refresh_palette();
+		line_cache_invalidate(&Live_cache);
+		render_thread_resync();
+	}
+}
+
 static const int increments[32] = {
 	0,
 	0,
@@ -1243,6 +2392,7 @@ void fx_vram_cache_write(uint32_t address, uint8_t value, uint8_t mask)
 				// Do nothing
 				break;
 		}
+		vram_written(address & 0x1FFFF);
 	}
 }
 
@@ -1259,6 +2409,22 @@ void vera_video_space_read_range(uint8_t *dest, uint32_t address, uint32_t size)
 	}
 }
 
+// Raw copy into VRAM; unlike vera_video_space_write(), this does not update palette or sprite state.
+void vera_video_space_write_range(uint32_t address, const uint8_t *src, uint32_t size)
+{
+	address &= 0x1FFFF;
+	if (address >= ADDR_VRAM_START && (address + size) <= ADDR_VRAM_END) {
+		memcpy(&video_ram[address], src, size);
+	} else {
+		const uint32_t tail_size = ADDR_VRAM_END - address;
+		memcpy(&video_ram[address], src, tail_size);
+		const uint32_t head_size = ((address + size) & 0x1FFFF);
+		memcpy(video_ram, src + tail_size, head_size);
+	}
+	line_cache_invalidate(&Live_cache);
+	render_thread_resync();
+}
+
 void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 {
 	if (fx_4bit_mode) {
@@ -1274,6 +2440,7 @@ void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 	} else {
 		if (!fx_trans_writes || value > 0) video_ram[address & 0x1FFFF] = value;
 	}
+	vram_written(address & 0x1FFFF);
 
 	if (address >= ADDR_PSG_START && address < ADDR_PSG_END) {
 		psg_writereg(address & 0x3f, value);
@@ -1289,6 +2456,7 @@ void fx_vera_video_space_write(uint32_t address, bool nibble, uint8_t value)
 void vera_video_space_write(uint32_t address, uint8_t value)
 {
 	video_ram[address & 0x1FFFF] = value;
+	vram_written(address & 0x1FFFF);
 
 	if (address >= ADDR_PSG_START && address < ADDR_PSG_END) {
 		psg_writereg(address & 0x3f, value);
@@ -1598,6 +2766,7 @@ void vera_video_write(uint8_t reg, uint8_t value)
 						video_ram[io_addr[1] & 0x1FFFF] = (fx_cache[fx_cache_byte_index] & 0x03) | (io_rddata[1] & 0xfc);
 						break;
 				}
+				vram_written(io_addr[1] & 0x1FFFF);
 				break; // break out of the enclosing switch statement early, too
 			}
 			bool nibble = fx_nibble_bit[reg - 3];
@@ -1846,9 +3015,58 @@ bool vera_video_is_special_address(uint32_t addr)
 
 const uint8_t *vera_video_get_framebuffer()
 {
+	render_thread_wait();
+	if (Framebuffer_stale) {
+		for (uint16_t y = 0; y < SCREEN_HEIGHT; ++y) {
+			const uint8_t *const line         = Indexed_lines + y * 4;
+			uint32_t *const      framebuffer4 = ((uint32_t *)framebuffer) + (y * SCREEN_WIDTH);
+			palette_lookup(framebuffer4, Indexed_pixels + y * SCREEN_WIDTH, Palette_slots[line[0] | (line[1] << 8)], SCREEN_WIDTH);
+			darken_safety_frame(framebuffer4, line[2]);
+		}
+		Framebuffer_stale = false;
+	}
 	return framebuffer;
 }
 
+void vera_video_set_indexed_output(bool enable)
+{
+	if (enable == Indexed_output) {
+		return;
+	}
+
+	// Lines kept from before only exist in one of the two buffers.
+	vera_video_get_framebuffer();
+	line_cache_invalidate(&Live_cache);
+	if (Render_thread_enabled) {
+		line_cache_invalidate(&Mirror->cache);
+	}
+
+	Indexed_output        = enable;
+	Palette_slot_source   = nullptr;
+	Palette_slots_changed = 0;
+}
+
+bool vera_video_get_indexed_output()
+{
+	return Indexed_output;
+}
+
+const vera_video_indexed_frame &vera_video_get_indexed_frame()
+{
+	static vera_video_indexed_frame frame;
+
+	render_thread_wait();
+	frame.pixels                 = Indexed_pixels;
+	frame.lines                  = Indexed_lines;
+	frame.palettes               = &Palette_slots[0][0];
+	frame.palettes_changed_first = Palette_slots_first;
+	frame.palettes_changed       = Palette_slots_changed;
+	frame.safe_x_begin           = (uint16_t)ceil(SCREEN_WIDTH * TITLE_SAFE_X);
+	frame.safe_x_end             = (uint16_t)floor(SCREEN_WIDTH * (1 - TITLE_SAFE_X)) + 1;
+	Palette_slots_changed        = 0;
+	return frame;
+}
+
 void vera_video_get_increment_values(const int **in, int *length)
 {
 	if (in != nullptr && length != nullptr) {
@@ -1971,9 +3189,14 @@ int vera_video_get_cheat_mask()
 	return cheat_mask;
 }
 
+void vera_video_set_skip_frame(bool skip)
+{
+	skip_frame = skip;
+}
+
 bool vera_video_is_cheat_frame()
 {
-	return frame_count & cheat_mask;
+	return skip_frame || (frame_count & cheat_mask);
 }
 
 void vera_video_set_log_video(bool enable)
@@ -2008,6 +3231,10 @@ void vera_video_get_expanded_vram(uint32_t address, int bpp, uint8_t *dest, uint
 
 const uint32_t *vera_video_get_palette_argb32()
 {
+	// With the render thread on, nothing else refreshes the live palette.
+	if (video_palette.dirty) {
+		refresh_palette();
+	}
 	return video_palette.entries;
 }
 
@@ -2031,6 +3258,12 @@ void vera_video_set_palette(int index, uint16_t argb16)
 	uint16_t *const p16 = reinterpret_cast<uint16_t *>(palette);
 	p16[index & 0xff]   = argb16;
 	video_palette.dirty = true;
+	line_cache_write(&Live_cache, ADDR_PALETTE_START);
+
+	if (Render_thread_enabled) {
+		render_thread_log(RENDER_LOG_PALETTE_ONLY | ((index & 0xff) * 2), palette[(index & 0xff) * 2]);
+		render_thread_log(RENDER_LOG_PALETTE_ONLY | ((index & 0xff) * 2 + 1), palette[(index & 0xff) * 2 + 1]);
+	}
 }
 
 const vera_video_layer_properties *vera_video_get_layer_properties(int layer)
@@ -2087,7 +3320,10 @@ bool vera_video_safety_frame_is_enabled(uint8_t video_mode)
 
 float vera_video_get_scan_pos_x()
 {
-	return (reg_composer[0] & 2) ? floorf((ntsc_half_cnt + (ntsc_scan_pos_y & 1) * NTSC_HALF_SCAN_WIDTH) / 2) : vga_scan_pos_x;
+	if (reg_composer[0] & 2) {
+		return floorf(((float)ntsc_half_cnt / SCAN_TICKS_PER_PIXEL + (ntsc_scan_pos_y & 1) * NTSC_HALF_SCAN_WIDTH) / 2);
+	}
+	return (float)vga_scan_pos_x / SCAN_TICKS_PER_PIXEL;
 }
 
 uint16_t vera_video_get_scan_pos_y()
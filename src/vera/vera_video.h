@@ -8,12 +8,18 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <vector>
 #include "files.h"
 
+class savestate;
+
 // both VGA and NTSC signal timing
 #define SCAN_WIDTH 800
 #define SCAN_HEIGHT 525
 
+// VRAM write tracking granularity, for vera_video_take_dirty_vram_pages()
+#define VERA_VIDEO_VRAM_PAGE_SIZE 512
+
 // visible area we're drawing
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
@@ -73,6 +79,28 @@ struct vera_video_sprite_properties {
 	uint16_t palette_offset;
 };
 
+// Palettes kept for indexed output, enough for a different one on every line.
+#define VERA_VIDEO_PALETTE_SLOTS 512
+
+// How a line of indexed output is darkened for the NTSC safety frame.
+#define VERA_VIDEO_SAFETY_NONE 0
+#define VERA_VIDEO_SAFETY_EDGES 1
+#define VERA_VIDEO_SAFETY_LINE 2
+
+struct vera_video_indexed_frame {
+	const uint8_t  *pixels;   // SCREEN_WIDTH x SCREEN_HEIGHT color indices
+	const uint8_t  *lines;    // 4 bytes per line: palette slot (low, high), safety mode, unused
+	const uint32_t *palettes; // VERA_VIDEO_PALETTE_SLOTS palettes of 256 ARGB entries
+
+	// Slots written since the last call, starting at palettes_changed_first and wrapping around.
+	uint16_t palettes_changed_first;
+	uint16_t palettes_changed;
+
+	// VERA_VIDEO_SAFETY_EDGES darkens the pixels before safe_x_begin and from safe_x_end on.
+	uint16_t safe_x_begin;
+	uint16_t safe_x_end;
+};
+
 struct vera_video_rect {
 	uint16_t hstart;
 	uint16_t hstop;
@@ -81,10 +109,20 @@ struct vera_video_rect {
 };
 
 void vera_video_reset(void);
-bool vera_video_step(float mhz, float cycles);
+bool vera_video_step(uint32_t mhz, uint32_t clocks);
+// CPU clocks until the next scan position that can raise an IRQ or finish a frame.
+uint32_t vera_video_clocks_until_next_event(uint32_t mhz);
 void vera_video_force_redraw_screen();
+// Render lines on a worker thread, so the CPU core can run ahead of the beam.
+void vera_video_set_render_thread(bool enable);
+bool vera_video_get_render_thread();
+// Scanlines reused from the previous frame, versus scanlines actually rendered.
+void vera_video_get_line_cache_stats(uint64_t *reused, uint64_t *rendered);
+// Appends the offset of each VRAM page written since the last call (or reset, restore, or range write).
+void vera_video_take_dirty_vram_pages(std::vector<uint32_t> &pages);
 bool vera_video_get_irq_out(void);
 void vera_video_save(x16file *f);
+void vera_video_save_restore(savestate &state);
 
 uint8_t vera_debug_video_read(uint8_t reg);
 uint8_t vera_video_read(uint8_t reg);
@@ -97,6 +135,7 @@ void    via1_write(uint8_t reg, uint8_t value);
 uint8_t vera_video_space_read(uint32_t address);
 void    vera_video_space_read_range(uint8_t *dest, uint32_t address, uint32_t size);
 void    vera_video_space_write(uint32_t address, uint8_t value);
+void    vera_video_space_write_range(uint32_t address, const uint8_t *src, uint32_t size);
 
 bool vera_video_is_tilemap_address(uint32_t addr);
 bool vera_video_is_tiledata_address(uint32_t addr);
@@ -104,6 +143,13 @@ bool vera_video_is_special_address(uint32_t addr);
 
 const uint8_t *vera_video_get_framebuffer();
 
+// Leave color indices and per-line palettes for the display to look up, rather than
+// expanding every line to ARGB. vera_video_get_framebuffer() still works, it just
+// does the lookup when asked.
+void                            vera_video_set_indexed_output(bool enable);
+bool                            vera_video_get_indexed_output();
+const vera_video_indexed_frame &vera_video_get_indexed_frame();
+
 void vera_video_get_increment_values(const int **in, int *length);
 
 const int vera_video_get_data_auto_increment(int channel);
@@ -134,6 +180,8 @@ void vera_video_set_dc_vstop(uint8_t value);
 
 void vera_video_set_cheat_mask(int mask);
 int  vera_video_get_cheat_mask();
+// Skips drawing the coming frame, like the cheat mask does, until cleared again.
+void vera_video_set_skip_frame(bool skip);
 bool vera_video_is_cheat_frame();
 void vera_video_set_log_video(bool enable);
 bool vera_video_get_log_video();
@@ -5,6 +5,7 @@
 
 #include "via.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,6 +15,7 @@
 #include "i2c.h"
 #include "joystick.h"
 #include "memory.h"
+#include "savestate.h"
 #include "serial.h"
 
 static struct via_t {
@@ -166,34 +168,41 @@ static void via_step(via_t &via, uint32_t clocks)
 
 	// Note that counters always update even if they're not "running"
 
-	// Timer 1 - always ticks on phi2
+	// Timer 1 - always ticks on phi2. A batch may span any number of underflows, each reload + 2 clocks apart.
 	{
 		const int32_t count        = via.timer_count[0] + 1;
 		const int32_t timer_clocks = (int32_t)clocks;
 		if (timer_clocks > count) {
+			const int32_t reload     = (uint16_t)(((uint32_t)via.registers[7] << 8) | via.registers[6]);
+			const int32_t period     = reload + 2;
+			const int32_t underflows = 1 + (timer_clocks - count - 1) / period;
+			const int32_t excess     = 1 + (timer_clocks - count - 1) % period;
 			if (via.timer_running[0]) {
 				ifr |= 0x40;
-				via.pb7_output ^= true;
-				via.timer_running[0] ^= ((acr & 0x40) == 0);
+				if (acr & 0x40) {
+					via.pb7_output ^= (underflows & 1) != 0;
+				} else {
+					via.pb7_output ^= true;
+					via.timer_running[0] = false;
+				}
 			}
-			const int32_t reload = (uint16_t)(((uint32_t)via.registers[7] << 8) | via.registers[6]);
-			via.timer_count[0]   = 1 + reload + count - timer_clocks;
+			via.timer_count[0] = reload + 1 - excess;
 		} else {
 			via.timer_count[0] -= timer_clocks;
 		}
 	}
 
-	// Timer 2 - ticks on phi2 or pb6 pulses depending on acr value.
+	// Timer 2 - ticks on phi2 or pb6 pulses depending on acr value, and wraps every 0x10000 ticks.
 	{
-		const uint32_t count                = via.timer_count[1];
-		const uint32_t timer_clocks         = (acr & 0x20) ? via.pb6_pulse_counts : clocks;
-		via.pb6_pulse_counts = 0;
+		const uint32_t count        = via.timer_count[1];
+		const uint32_t timer_clocks = (acr & 0x20) ? via.pb6_pulse_counts : clocks;
+		via.pb6_pulse_counts        = 0;
 		if (timer_clocks > count) {
 			if (via.timer_running[1]) {
 				ifr |= 0x20;
 				via.timer_running[1] = false;
 			}
-			via.timer_count[1] = 0x10000 + count - timer_clocks;
+			via.timer_count[1] = (count - timer_clocks) & 0xffff;
 		} else {
 			via.timer_count[1] -= timer_clocks;
 		}
@@ -202,6 +211,19 @@ static void via_step(via_t &via, uint32_t clocks)
 	// TODO Cxx pin and shift register handling
 }
 
+static uint32_t via_clocks_until_irq(const via_t &via)
+{
+	// Only running timers raise IFR bits, and via_step() keeps the counters exact across any batch length.
+	int64_t clocks = UINT32_MAX;
+	if (via.timer_running[0]) {
+		clocks = std::min<int64_t>(clocks, (int64_t)via.timer_count[0] + 2);
+	}
+	if (via.timer_running[1] && (via.registers[11] & 0x20) == 0) {
+		clocks = std::min<int64_t>(clocks, (int64_t)via.timer_count[1] + 1);
+	}
+	return (uint32_t)std::max<int64_t>(clocks, 1);
+}
+
 //
 // VIA#1
 //
@@ -311,6 +333,11 @@ bool via1_irq()
 	return (via[0].registers[13] & via[0].registers[14]) != 0;
 }
 
+uint32_t via1_clocks_until_irq()
+{
+	return via_clocks_until_irq(via[0]);
+}
+
 //
 // VIA#2
 //
@@ -342,3 +369,13 @@ bool via2_irq()
 {
 	return (via[1].registers[13] & via[1].registers[14]) != 0;
 }
+
+uint32_t via2_clocks_until_irq()
+{
+	return via_clocks_until_irq(via[1]);
+}
+
+void via_save_restore(savestate &state)
+{
+	state.save_restore(via);
+}
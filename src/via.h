@@ -9,16 +9,22 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+class savestate;
+
 void    via1_init();
 uint8_t via1_read(uint8_t reg, bool debug);
 void    via1_write(uint8_t reg, uint8_t value);
 void    via1_step(uint32_t clocks);
 bool    via1_irq();
+uint32_t via1_clocks_until_irq();
 
 void    via2_init();
 uint8_t via2_read(uint8_t reg, bool debug);
 void    via2_write(uint8_t reg, uint8_t value);
 void    via2_step(uint32_t clocks);
 bool    via2_irq();
+uint32_t via2_clocks_until_irq();
+
+void    via_save_restore(savestate &state);
 
 #endif
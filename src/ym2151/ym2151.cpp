@@ -1,13 +1,33 @@
 #include "ym2151.h"
 
-#include <queue>
+#include <algorithm>
 
 #include "ymfm_opm.h"
 
 #include "ymfm_fm.ipp"
 
-#include "audio.h"
 #include "bitutils.h"
+#include "cpu/fake6502.h"
+#include "ring_buffer.h"
+#include "savestate.h"
+
+// The resampler's dot products use whatever vector unit the compiler targets, and plain C++ otherwise.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define YM_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define YM_SIMD_NEON
+#endif
+
+// Writes made while the chip is busy wait here, stamped with the CPU clock they were made at.
+#define YM_WRITE_QUEUE_SIZE 1024
+
+struct ym_queued_write {
+	uint64_t clock;
+	uint8_t  addr;
+	uint8_t  value;
+};
 
 class ym2151_interface : public ymfm::ymfm_interface
 {
@@ -21,8 +41,23 @@ public:
 	      m_previous_samples{ { 0, 0 }, { 0, 0 } },
 	      m_timers{0, 0},
 	      m_busy_timer{ 0 },
-	      m_irq_status{ false }
+	      m_irq_status{ false },
+	      m_idle(false),
+	      m_resample_position(0),
+	      m_resample_rate(0),
+	      m_resample_window{}
 	{
+		// Split the kernel into one filter per phase of the upsampled signal, oldest tap first,
+		// with each tap twice over so a single dot product covers both channels.
+		for (int phase = 0; phase < upsampling_factor; ++phase) {
+			for (int k = 0; k < phase_taps; ++k) {
+				const int   filter_index = phase + k * upsampling_factor;
+				const float tap          = filter_index < filter_kernel_length ? (float)filter_kernel[filter_index] : 0.0f;
+
+				m_phases[phase][(phase_taps - 1 - k) * 2 + 0] = tap;
+				m_phases[phase][(phase_taps - 1 - k) * 2 + 1] = tap;
+			}
+		}
 	}
 
 	~ym2151_interface()
@@ -129,44 +164,59 @@ public:
 				m_timers[i] = std::max(0, m_timers[i] - (64 * cycles));
 				if (m_timers[i] <= 0) {
 					m_engine->engine_timer_expired(i);
+					// Timer A can key on every channel in CSM mode.
+					m_idle = false;
 				}
 			}
 		}	
 	}
 
-	void pregenerate()
+	// Every operator has been released and has faded out completely, so the chip can only
+	// output zeroes until something is written to it.
+	bool is_silent() const
 	{
-		if (m_backbuffer_used < m_backbuffer_size) {
-			if (m_write_queue.size() > 0) {
-				auto [addr, value] = m_write_queue.front();
-				m_chip.write_address(addr);
-				m_chip.write_data(value, false);
+		for (uint32_t slnum = 0; slnum < MAX_YM2151_SLOTS; ++slnum) {
+			const auto *op = m_chip.get_debug_op(slnum);
+			if (op->debug_eg_state() != ymfm::EG_RELEASE || op->debug_eg_attenuation() < 0x3ff) {
+				return false;
 			}
-
-			m_chip.generate(&m_backbuffer[m_backbuffer_used], 1);
-			update_clocks();
-			++m_backbuffer_used;
 		}
+		return true;
 	}
-		
 
-	void pregenerate(uint32_t samples)
+	// Generate samples ending every clocks_per_sample CPU clocks, the first of them at first_clock.
+	void pregenerate(uint32_t samples, uint64_t first_clock, uint32_t clocks_per_sample)
 	{
 		if (m_backbuffer_used + samples > m_backbuffer_size) {
 			samples = m_backbuffer_size - m_backbuffer_used;
 		}
+		if (samples == 0) {
+			return;
+		}
 
-		while (samples > 0 && m_write_queue.size() > 0) {
-			auto [addr, value] = m_write_queue.front();
-			m_chip.write_address(addr);
-			m_chip.write_data(value, false);
+		if (m_idle) {
+			// Skip synthesis, but keep the timers and busy flag running.
+			memset(&m_backbuffer[m_backbuffer_used], 0, sizeof(ymfm::ym2151::output_data) * samples);
+			m_backbuffer_used += samples;
+			update_clocks(samples);
+			return;
+		}
+
+		// Queued writes go in at the first sample that ends after them, once the chip isn't busy.
+		uint64_t sample_clock = first_clock;
+		while (samples > 0 && m_write_queue.count() > 0) {
+			const ym_queued_write &write = m_write_queue.get_oldest();
+			if (write.clock < sample_clock && !ymfm_is_busy()) {
+				m_chip.write_address(write.addr);
+				m_chip.write_data(write.value, false);
+				m_write_queue.pop_oldest();
+			}
 
 			m_chip.generate(&m_backbuffer[m_backbuffer_used], 1);
 			update_clocks();
 			++m_backbuffer_used;
 			--samples;
-
-			m_write_queue.pop();
+			sample_clock += clocks_per_sample;
 		}
 
 		if (samples > 0) {
@@ -175,50 +225,82 @@ public:
 
 			m_backbuffer_used += samples;
 		}
+
+		m_idle = m_write_queue.count() == 0 && is_silent();
+	}
+
+	// Both channels of one output sample, from the phase filter and the oldest of the input samples it covers.
+	static void resample(int16_t *out, const float *taps, const float *window)
+	{
+#if defined(YM_SIMD_SSE2)
+		__m128 sum = _mm_setzero_ps();
+		for (int i = 0; i < phase_taps * 2; i += 4) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(taps + i), _mm_loadu_ps(window + i)));
+		}
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		float lr[4];
+		_mm_storeu_ps(lr, sum);
+#elif defined(YM_SIMD_NEON)
+		float32x4_t sum = vdupq_n_f32(0.0f);
+		for (int i = 0; i < phase_taps * 2; i += 4) {
+			sum = vmlaq_f32(sum, vld1q_f32(taps + i), vld1q_f32(window + i));
+		}
+		float lr[2];
+		vst1_f32(lr, vadd_f32(vget_low_f32(sum), vget_high_f32(sum)));
+#else
+		float lr[2] = { 0.0f, 0.0f };
+		for (int i = 0; i < phase_taps * 2; i += 2) {
+			lr[0] += taps[i] * window[i];
+			lr[1] += taps[i + 1] * window[i + 1];
+		}
+#endif
+		for (int i = 0; i < 2; ++i) {
+			out[i] = (int16_t)std::clamp(lr[i], -32768.0f, 32767.0f);
+		}
 	}
 
 	void generate(int16_t *buffers, uint32_t samples, uint32_t sample_rate)
 	{
-		uint32_t samples_needed = samples * m_chip_sample_rate / sample_rate;
-		if (m_backbuffer_used < samples_needed) {
-			pregenerate(samples_needed - m_backbuffer_used);
+		if (sample_rate != m_resample_rate) {
+			m_resample_position = 0;
+			m_resample_rate     = sample_rate;
 		}
 
-		uint32_t samples_used = 0;
-
-		// iterate over output samples
-		int16_t *out_streams[2] = {&buffers[0], &buffers[1]};
-		for (uint32_t s = 0; s < samples; s++) {
-			// which sample in the upsampled, filtered signal will we use for the given output sample?
-			int32_t pick_index = (int32_t)(((float)(s * m_chip_sample_rate * upsampling_factor)) / sample_rate);
-			// now, compute this sample (L/R)
-			for (int i = 0; i < 2; i++) {
-				double sum = 0.0f;
-				int32_t source_sample = pick_index / upsampling_factor;
-				int32_t k = 0;
-				for (int32_t filter_index = pick_index % upsampling_factor; filter_index < filter_kernel_length; filter_index += upsampling_factor) {
-					if (source_sample - k >= 0) {
-						sum += filter_kernel[filter_index] * m_backbuffer[source_sample - k].data[i];
-					} else {
-						sum += filter_kernel[filter_index] * m_filter_memory[k - source_sample - 1].data[i];
-					}
-					k++;
-				}
-				*out_streams[i] = (int16_t)(sum);
-				out_streams[i] += 2;
-			}
+		// Positions are in the upsampled signal, scaled by the output sample rate, so they never drift.
+		// Input sample n is at n * upsampling_factor, and the window holds the history before input 0.
+		const uint64_t step       = (uint64_t)m_chip_sample_rate * upsampling_factor;
+		const uint64_t scale      = (uint64_t)sample_rate * upsampling_factor;
+		const uint64_t end        = m_resample_position + samples * step;
+		const uint32_t last_input = (uint32_t)((end - step) / scale);
+		const uint32_t next_input = (uint32_t)(end / scale);
+		const uint32_t needed     = std::min(std::max(last_input + 1, next_input), m_backbuffer_size);
+		if (m_backbuffer_used < needed) {
+			// These samples are ahead of the CPU, so anything queued is already due.
+			pregenerate(needed - m_backbuffer_used, clockticks6502 + clocks_per_sample(), clocks_per_sample());
+		}
+
+		float *const inputs = m_resample_window + phase_history * 2;
+		for (uint32_t s = 0; s < needed; ++s) {
+			inputs[s * 2 + 0] = (float)m_backbuffer[s].data[0];
+			inputs[s * 2 + 1] = (float)m_backbuffer[s].data[1];
 		}
 
-		// fill filter memory with the last few input samples
-		for (int32_t s = 0; s < filter_memory_length; s++) {
-			m_filter_memory[s] = m_backbuffer[samples_needed - 1 - s];
+		uint64_t position = m_resample_position;
+		for (uint32_t s = 0; s < samples; ++s) {
+			const uint64_t upsampled = position / sample_rate;
+			const uint32_t input     = (uint32_t)(upsampled / upsampling_factor);
+			const uint32_t phase     = (uint32_t)(upsampled % upsampling_factor);
+			resample(&buffers[s * 2], m_phases[phase], m_resample_window + input * 2);
+			position += step;
 		}
 
-		samples_used = samples_needed;
+		// Keep the inputs the next call still reaches back to.
+		memmove(m_resample_window, m_resample_window + next_input * 2, sizeof(float) * phase_history * 2);
+		m_resample_position = end - next_input * scale;
 
-		if (samples_used < m_backbuffer_used) {
-			memmove(&m_backbuffer[0], &m_backbuffer[samples_used], sizeof(ymfm::ym2151::output_data) * (m_backbuffer_used - samples_used));
-			m_backbuffer_used -= samples;
+		if (next_input < m_backbuffer_used) {
+			memmove(&m_backbuffer[0], &m_backbuffer[next_input], sizeof(ymfm::ym2151::output_data) * (m_backbuffer_used - next_input));
+			m_backbuffer_used -= next_input;
 		} else {
 			m_backbuffer_used = 0;
 		}
@@ -231,12 +313,17 @@ public:
 
 	void write(uint8_t addr, uint8_t value)
 	{
-		if (ymfm_is_busy()) {
-			if (YM_is_strict()) {
-				fmt::print("WARN: Write to YM2151 (${:02X} <- ${:02X}) while busy.\n", (int)addr, (int)value);
-			} else {
-				m_write_queue.push({ addr, value });
+		m_idle = false;
+		if (ymfm_is_busy() && YM_is_strict()) {
+			fmt::print("WARN: Write to YM2151 (${:02X} <- ${:02X}) while busy.\n", (int)addr, (int)value);
+		} else if (ymfm_is_busy() || m_write_queue.count() > 0) {
+			// Later writes queue up behind earlier ones, so they land in order.
+			if (m_write_queue.size_remaining() == 0) {
+				const ym_queued_write &oldest = m_write_queue.pop_oldest();
+				m_chip.write_address(oldest.addr);
+				m_chip.write_data(oldest.value, false);
 			}
+			m_write_queue.add({ clockticks6502, addr, value });
 		} else {
 			m_chip.write_address(addr);
 			m_chip.write_data(value, false);
@@ -246,11 +333,51 @@ public:
 	void reset()
 	{
 		m_chip.reset();
+		m_idle = false;
+	}
+
+	void save_restore(savestate &state)
+	{
+		// The chip itself goes through ymfm's own save/restore, stored as a length-prefixed blob.
+		std::vector<uint8_t> chip_state;
+		if (state.saving()) {
+			ymfm::ymfm_saved_state saver(chip_state, true);
+			m_chip.save_restore(saver);
+		}
+		uint32_t chip_state_size = (uint32_t)chip_state.size();
+		state.save_restore(chip_state_size);
+		chip_state.resize(chip_state_size);
+		state.save_restore(chip_state.data(), chip_state_size);
+		if (!state.saving()) {
+			ymfm::ymfm_saved_state restorer(chip_state, false);
+			m_chip.save_restore(restorer);
+		}
+
+		state.save_restore(m_timers);
+		state.save_restore(m_busy_timer);
+		state.save_restore(m_irq_status);
+		m_idle = false;
+
+		uint32_t queued_writes = (uint32_t)m_write_queue.count();
+		state.save_restore(queued_writes);
+		if (!state.saving()) {
+			m_write_queue.clear();
+		}
+		for (uint32_t i = 0; i < queued_writes && !state.failed(); ++i) {
+			ym_queued_write write = state.saving() ? m_write_queue.get(i) : ym_queued_write{};
+			state.save_restore(write.clock);
+			state.save_restore(write.addr);
+			state.save_restore(write.value);
+			if (!state.saving() && m_write_queue.size_remaining() > 0) {
+				m_write_queue.add(write);
+			}
+		}
 	}
 
 	void debug_write(uint8_t addr, uint8_t value)
 	{
 		// do a direct write without triggering the busy timer
+		m_idle = false;
 		m_chip.write_address(addr);
 		m_chip.write_data(value, true);
 	}
@@ -324,6 +451,11 @@ public:
 		return m_chip_sample_rate;
 	}
 
+	uint32_t clocks_per_sample() const
+	{
+		return 8000000 / m_chip_sample_rate;
+	}
+
 private:
 	ymfm::ym2151 m_chip;
 	uint32_t     m_chip_sample_rate;
@@ -333,7 +465,7 @@ private:
 	uint32_t                  m_backbuffer_size;
 	uint32_t                  m_backbuffer_used;
 
-	std::queue<std::tuple<uint8_t, uint8_t>> m_write_queue;
+	ring_buffer<ym_queued_write, YM_WRITE_QUEUE_SIZE> m_write_queue;
 
 	ymfm::ym2151::output_data m_previous_samples[2];
 
@@ -342,35 +474,52 @@ private:
 
 	bool m_irq_status;
 
+	// Set while is_silent(), so synthesis can be skipped until the next write.
+	bool m_idle;
+
 	static constexpr int upsampling_factor = 8;
 
 #include "resampling_filter_kernel.inl"
-	
-	static constexpr int filter_memory_length = filter_kernel_length / upsampling_factor + 1;
-	ymfm::ym2151::output_data m_filter_memory[filter_kernel_length];
+
+	static constexpr int phase_taps    = (filter_kernel_length + upsampling_factor - 1) / upsampling_factor;
+	static constexpr int phase_history = phase_taps - 1;
+
+	alignas(16) float m_phases[upsampling_factor][phase_taps * 2];
+
+	uint64_t m_resample_position;
+	uint32_t m_resample_rate;
+	float    m_resample_window[(phase_history + YM_SAMPLE_RATE) * 2];
 };
 
 static ym2151_interface Ym_interface;
 static uint8_t          Last_address = 0;
 static uint8_t          Last_data    = 0;
 static uint8_t          Ym_registers[256];
-static bool             Ym_irq_enabled = false;
-static bool             Ym_strict_busy = false;
+static bool             Ym_irq_enabled    = false;
+static bool             Ym_strict_busy    = false;
+static uint32_t         Ym_clocks_elapsed = 0;
 
 void YM_prerender(uint32_t clocks)
 {
-	static uint32_t clocks_elapsed = 0;
-	clocks_elapsed += clocks;
+	Ym_clocks_elapsed += clocks;
 
-	const uint32_t clocks_per_sample = 8000000 / Ym_interface.get_sample_rate();
-	const uint32_t samples_to_render = clocks_elapsed / clocks_per_sample;
+	const uint32_t clocks_per_sample = Ym_interface.clocks_per_sample();
+	const uint32_t samples_to_render = Ym_clocks_elapsed / clocks_per_sample;
 
 	if (samples_to_render > 0) {
-		Ym_interface.pregenerate(samples_to_render);
-		clocks_elapsed -= samples_to_render * clocks_per_sample;
+		Ym_clocks_elapsed -= samples_to_render * clocks_per_sample;
+		// The last sample ends where the clocks left over begin.
+		const uint64_t last_clock = clockticks6502 - Ym_clocks_elapsed;
+		Ym_interface.pregenerate(samples_to_render, last_clock - (uint64_t)(samples_to_render - 1) * clocks_per_sample, clocks_per_sample);
 	}
 }
 
+uint32_t YM_clocks_until_next_sample()
+{
+	const uint32_t clocks_per_sample = Ym_interface.clocks_per_sample();
+	return clocks_per_sample - Ym_clocks_elapsed % clocks_per_sample;
+}
+
 void YM_render(int16_t *buffer, uint32_t samples, uint32_t sample_rate)
 {
 	Ym_interface.generate(buffer, samples, sample_rate);
@@ -436,6 +585,15 @@ void YM_reset()
 	memset(&Ym_registers[0x20], 0xc0, 8);
 }
 
+void YM_save_restore(savestate &state)
+{
+	Ym_interface.save_restore(state);
+	state.save_restore(Last_address);
+	state.save_restore(Last_data);
+	state.save_restore(Ym_registers);
+	state.save_restore(Ym_clocks_elapsed);
+}
+
 void YM_debug_write(uint8_t addr, uint8_t value)
 {
 	Ym_registers[addr] = value;
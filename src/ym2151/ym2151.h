@@ -29,7 +29,10 @@
 #	define YM_CLOCK_RATE (3579545)
 #	define YM_SAMPLE_RATE (YM_CLOCK_RATE >> 6)
 
+class savestate;
+
 void     YM_prerender(uint32_t clocks);
+uint32_t YM_clocks_until_next_sample();
 void     YM_render(int16_t *buffers, uint32_t samples, uint32_t sample_rate);
 void     YM_clear_backbuffer();
 uint32_t YM_get_sample_rate();
@@ -44,6 +47,7 @@ void    YM_write(uint8_t offset, uint8_t value);
 uint8_t YM_read_status();
 bool    YM_irq();
 void    YM_reset();
+void    YM_save_restore(savestate &state);
 
 // debug stuff
 void    YM_debug_write(uint8_t addr, uint8_t value);